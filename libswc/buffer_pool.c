@@ -0,0 +1,151 @@
+/* swc: libswc/buffer_pool.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "buffer_pool.h"
+#include "drm.h"
+#include "internal.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <wayland-server.h>
+#include <wld/wld.h>
+
+/* Dimensions are rounded up to this many pixels, so that a buffer is reused
+ * while a window is resized within the same bucket. */
+#define BUCKET_SIZE 64
+
+/* The most memory kept in idle buffers. */
+#define MAX_IDLE_SIZE (64 << 20)
+
+/* Idle buffers are freed once no buffer has been returned for this long,
+ * for example after an interactive resize ends. */
+#define IDLE_TIMEOUT 10000
+
+struct entry {
+	struct wld_buffer *buffer;
+	struct wl_list link;
+};
+
+static struct {
+	/* Idle buffers, most recently used first. */
+	struct wl_list idle;
+	size_t idle_size;
+	struct wl_event_source *timer;
+} pool;
+
+static uint32_t
+bucket(uint32_t size)
+{
+	return (size + BUCKET_SIZE - 1) / BUCKET_SIZE * BUCKET_SIZE;
+}
+
+static size_t
+buffer_size(struct wld_buffer *buffer)
+{
+	return (size_t)buffer->pitch * buffer->height;
+}
+
+static void
+evict(struct entry *entry)
+{
+	pool.idle_size -= buffer_size(entry->buffer);
+	wld_buffer_unreference(entry->buffer);
+	wl_list_remove(&entry->link);
+	free(entry);
+}
+
+static int
+handle_timeout(void *data)
+{
+	struct entry *entry, *tmp;
+
+	wl_list_for_each_safe (entry, tmp, &pool.idle, link)
+		evict(entry);
+
+	return 0;
+}
+
+bool
+buffer_pool_initialize(void)
+{
+	wl_list_init(&pool.idle);
+	pool.idle_size = 0;
+	pool.timer = wl_event_loop_add_timer(swc.event_loop, &handle_timeout, NULL);
+
+	return pool.timer;
+}
+
+void
+buffer_pool_finalize(void)
+{
+	handle_timeout(NULL);
+	wl_event_source_remove(pool.timer);
+	pool.timer = NULL;
+}
+
+struct wld_buffer *
+buffer_pool_get(uint32_t width, uint32_t height, uint32_t format)
+{
+	struct entry *entry;
+	struct wld_buffer *buffer;
+
+	wl_list_for_each (entry, &pool.idle, link) {
+		if (buffer_pool_fits(entry->buffer, width, height, format)) {
+			buffer = entry->buffer;
+			pool.idle_size -= buffer_size(buffer);
+			wl_list_remove(&entry->link);
+			free(entry);
+			return buffer;
+		}
+	}
+
+	return wld_create_buffer(swc.drm->context, bucket(width), bucket(height), format, WLD_FLAG_MAP);
+}
+
+bool
+buffer_pool_fits(struct wld_buffer *buffer, uint32_t width, uint32_t height, uint32_t format)
+{
+	return buffer->format == format && buffer->width == bucket(width) && buffer->height == bucket(height);
+}
+
+void
+buffer_pool_put(struct wld_buffer *buffer)
+{
+	struct entry *entry;
+
+	/* Views may outlive the compositor when clients are disconnected. */
+	if (!pool.timer || !(entry = malloc(sizeof(*entry)))) {
+		wld_buffer_unreference(buffer);
+		return;
+	}
+	entry->buffer = buffer;
+	wl_list_insert(&pool.idle, &entry->link);
+	pool.idle_size += buffer_size(buffer);
+
+	/* Evict the least recently used buffers to stay under the limit. */
+	while (pool.idle_size > MAX_IDLE_SIZE) {
+		entry = wl_container_of(pool.idle.prev, entry, link);
+		evict(entry);
+	}
+	wl_event_source_timer_update(pool.timer, IDLE_TIMEOUT);
+}
@@ -0,0 +1,53 @@
+/* swc: libswc/buffer_pool.h
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SWC_BUFFER_POOL_H
+#define SWC_BUFFER_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct wld_buffer;
+
+bool buffer_pool_initialize(void);
+void buffer_pool_finalize(void);
+
+/**
+ * Returns a mappable buffer in the DRM context at least as large as the given
+ * dimensions, reusing an idle one from the pool if possible. Its contents are
+ * undefined.
+ */
+struct wld_buffer *buffer_pool_get(uint32_t width, uint32_t height, uint32_t format);
+
+/**
+ * Returns whether a buffer from the pool is the one that would be chosen for
+ * the given dimensions, so it can be kept across a resize.
+ */
+bool buffer_pool_fits(struct wld_buffer *buffer, uint32_t width, uint32_t height, uint32_t format);
+
+/**
+ * Gives a buffer back to the pool, which takes over the caller's reference.
+ */
+void buffer_pool_put(struct wld_buffer *buffer);
+
+#endif
@@ -29,31 +29,46 @@
  */
 
 #include "compositor.h"
+#include "buffer_pool.h"
 #include "data_device_manager.h"
+#include "dmabuf.h"
 #include "drm.h"
 #include "event.h"
 #include "internal.h"
 #include "launch.h"
 #include "output.h"
+#include "plane.h"
 #include "pointer.h"
 #include "region.h"
 #include "screen.h"
 #include "seat.h"
 #include "shm.h"
+#include "single_pixel_buffer.h"
 #include "surface.h"
 #include "swc.h"
+#include "thread_pool.h"
 #include "util.h"
 #include "view.h"
+#include "wayland_buffer.h"
+#include "window.h"
 
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wld/drm.h>
 #include <wld/wld.h>
 #include <xkbcommon/xkbcommon-keysyms.h>
 
+/* Proxies of views hidden for this many milliseconds are dropped. */
+#define PROXY_RECLAIM_DELAY 30000
+
+/* Proxies of hidden views are also dropped while all proxies together take
+ * more memory than this. */
+#define PROXY_BUDGET (256 << 20)
+
 struct target {
 	struct wld_surface *surface;
 	struct wld_buffer *next_buffer, *current_buffer;
@@ -61,11 +76,40 @@ struct target {
 	struct view_handler view_handler;
 	uint32_t mask;
 
+	/* Whether the last frame was a client buffer scanned out directly. */
+	bool scanout;
+
+	/* The client buffers scanned out in the frame waiting for its page flip
+	 * and in the frame on screen, as arrays of struct wld_buffer *. They are
+	 * locked until the frame after theirs is displayed. */
+	struct wl_array next_locks, current_locks;
+
+	/* Repaints are started a margin before the vertical blank predicted from
+	 * the time of the last page flip and the refresh rate of the screen. The
+	 * time is in microseconds, on the clock of the DRM device's timestamps. */
+	struct screen *screen;
+	uint64_t last_frame;
+	bool repaint_scheduled;
+	struct wl_event_source *repaint_timer, *repaint_idle;
+
+	/* With a frame budget, the views are sent the frame that was displayed
+	 * only once the budget before the next repaint is left. */
+	struct wl_event_source *frame_timer;
+	struct frame_info frame_info;
+	bool frame_pending, frame_info_valid;
+
+	/* A copy of the screen contents in cached memory, in which frames are
+	 * composited before their damage is copied to the scanout buffer, and the
+	 * damage it has yet to be repainted for. NULL if not used. */
+	uint32_t *shadow;
+	pixman_region32_t shadow_damage;
+
 	struct wl_listener screen_destroy_listener;
 };
 
 static bool handle_motion(struct pointer_handler *handler, uint32_t time, wl_fixed_t x, wl_fixed_t y);
-static void perform_update(void *data);
+static void perform_update(uint32_t screens);
+static void target_schedule_repaint(struct target *target);
 
 static struct pointer_handler pointer_handler = {
 	.motion = handle_motion,
@@ -84,18 +128,72 @@ static struct {
 
 	bool updating;
 	struct wl_global *global;
-} compositor;
+
+	/* Time in milliseconds before the vertical blank at which repaints start. */
+	uint32_t repaint_margin;
+
+	/* Time in milliseconds before a repaint at which frame callbacks are
+	 * sent, or 0 to send them once the previous frame is displayed. */
+	uint32_t frame_budget;
+
+	/* Visible views by the area of the screens they cover. Their grid order
+	 * follows the stacking order, top to bottom. */
+	struct grid grid;
+	uint64_t top_order, bottom_order;
+
+	/* Threads compositing in parallel when rendering with pixman, or NULL. */
+	struct thread_pool *render_pool;
+	unsigned render_threads;
+
+	/* Whether the renderer composites with pixman on the CPU, and whether
+	 * targets are then composited into shadow buffers. */
+	bool pixman, shadow;
+
+	/* Expires when the proxy of a hidden view is due to be reclaimed. */
+	struct wl_event_source *reclaim_timer;
+} compositor = {
+	.repaint_margin = 7,
+	.top_order = UINT64_MAX / 2,
+	.bottom_order = UINT64_MAX / 2 + 1,
+};
 
 struct swc_compositor swc_compositor = {
 	.pointer_handler = &pointer_handler,
 };
 
+static void
+unlock_buffers(struct wl_array *locks)
+{
+	struct wld_buffer **buffer;
+
+	wl_array_for_each (buffer, locks)
+		wayland_buffer_unlock(*buffer);
+	locks->size = 0;
+}
+
 static void
 handle_screen_destroy(struct wl_listener *listener, void *data)
 {
 	struct target *target = wl_container_of(listener, target, screen_destroy_listener);
+	struct compositor_view *view;
 
+	/* Surfaces must not keep referring to the screen's planes. */
+	wl_list_for_each (view, &compositor.views, link) {
+		if (view->surface->scanout_plane && view->surface->scanout_plane->screen == target->screen)
+			dmabuf_set_scanout_plane(view->surface, NULL);
+	}
+
+	if (target->repaint_idle)
+		wl_event_source_remove(target->repaint_idle);
+	wl_event_source_remove(target->repaint_timer);
+	wl_event_source_remove(target->frame_timer);
 	wld_destroy_surface(target->surface);
+	free(target->shadow);
+	pixman_region32_fini(&target->shadow_damage);
+	unlock_buffers(&target->next_locks);
+	unlock_buffers(&target->current_locks);
+	wl_array_release(&target->next_locks);
+	wl_array_release(&target->current_locks);
 	free(target);
 }
 
@@ -108,68 +206,303 @@ target_get(struct screen *screen)
 	return listener ? wl_container_of(listener, target, screen_destroy_listener) : NULL;
 }
 
+/**
+ * Returns the current time in microseconds, on the clock of the DRM device's
+ * timestamps.
+ */
+static uint64_t
+frame_clock_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(swc.drm->clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Sends the frame that was last displayed to the views on the target, if they
+ * have not been sent it yet.
+ */
 static void
-handle_screen_frame(struct view_handler *handler, uint32_t time)
+target_send_frame(struct target *target)
 {
-	struct target *target = wl_container_of(handler, target, view_handler);
 	struct compositor_view *view;
 
-	compositor.pending_flips &= ~target->mask;
-
+	if (!target->frame_pending)
+		return;
+	target->frame_pending = false;
 	wl_list_for_each (view, &compositor.views, link) {
 		if (view->visible && view->base.screens & target->mask)
-			view_frame(&view->base, time);
+			view_frame(&view->base, target->frame_info_valid ? &target->frame_info : NULL);
 	}
+}
+
+static int
+handle_frame_timer(void *data)
+{
+	target_send_frame(data);
+	return 0;
+}
+
+/**
+ * Returns the time in milliseconds until the given number of microseconds
+ * before the next vertical blank of the target's screen, or 0 if that has
+ * passed or the screen is not to be synchronized to the vertical blank.
+ */
+static uint32_t
+target_time_until_vblank(struct target *target, uint32_t lead)
+{
+	struct primary_plane *primary = &target->screen->planes.primary;
+	uint32_t refresh = primary->mode.refresh, period;
+	uint64_t elapsed;
+
+	/* A client scanned out with tearing wants its content displayed as soon as
+	 * possible, so don't wait for the vertical blank. With adaptive sync, the
+	 * vertical blank waits for the scanned out client instead. */
+	if (refresh == 0 || !target->last_frame || primary->flipped_async || (primary->vrr && target->scanout))
+		return 0;
+
+	/* Refresh is in mHz, the period in microseconds. */
+	period = 1000000000 / refresh;
+	elapsed = frame_clock_usec() - target->last_frame;
+	if (elapsed >= period || period - elapsed <= lead)
+		return 0;
+
+	return (period - elapsed - lead) / 1000;
+}
 
-	if (target->current_buffer)
-		wld_surface_release(target->surface, target->current_buffer);
+static void
+handle_screen_frame(struct view_handler *handler, const struct frame_info *info)
+{
+	struct target *target = wl_container_of(handler, target, view_handler);
+	struct wl_array locks;
+	uint32_t delay;
+
+	compositor.pending_flips &= ~target->mask;
 
-	target->current_buffer = target->next_buffer;
+	/* Any frame not sent yet is superseded by this one. */
+	target_send_frame(target);
+	target->frame_pending = true;
+	target->frame_info_valid = info != NULL;
+	if (info)
+		target->frame_info = *info;
+
+	target->last_frame = info ? (uint64_t)info->time.tv_sec * 1000000 + info->time.tv_nsec / 1000 : frame_clock_usec();
+
+	if (target->screen->planes.primary.discarded) {
+		/* The frame could not be committed, so the previous one is
+		 * still on screen and keeps its buffers. */
+		if (target->next_buffer)
+			wld_surface_release(target->surface, target->next_buffer);
+		target->next_buffer = NULL;
+		unlock_buffers(&target->next_locks);
+	} else {
+		if (target->current_buffer)
+			wld_surface_release(target->surface, target->current_buffer);
+		target->current_buffer = target->next_buffer;
+
+		/* The client buffers of the previous frame have now left the
+		 * screen. */
+		unlock_buffers(&target->current_locks);
+		locks = target->current_locks;
+		target->current_locks = target->next_locks;
+		target->next_locks = locks;
+	}
+
+	/* Clients are sent the frame their budget before the next repaint. */
+	delay = 0;
+	if (compositor.frame_budget > 0)
+		delay = target_time_until_vblank(target, (compositor.repaint_margin + compositor.frame_budget) * 1000);
+	if (delay > 0)
+		wl_event_source_timer_update(target->frame_timer, delay);
+	else
+		target_send_frame(target);
 
 	/* If we had scheduled updates that couldn't run because we were waiting on a
-	 * page flip, run them now. If the compositor is currently updating, then the
-	 * frame finished immediately, and we can be sure that there are no pending
-	 * updates. */
-	if (compositor.scheduled_updates && !compositor.updating)
-		perform_update(NULL);
+	 * page flip, schedule them for the next vertical blank. If the compositor is
+	 * currently updating, then the frame finished immediately, and we can be
+	 * sure that there are no pending updates. */
+	if (compositor.scheduled_updates & target->mask && !compositor.updating)
+		target_schedule_repaint(target);
 }
 
 static const struct view_handler_impl screen_view_handler = {
 	.frame = handle_screen_frame,
 };
 
+/**
+ * Locks a client buffer scanned out in the frame being flipped to.
+ */
+static void
+target_lock_buffer(struct target *target, struct wld_buffer *buffer)
+{
+	struct wld_buffer **entry;
+
+	if (!(entry = wl_array_add(&target->next_locks, sizeof(*entry)))) {
+		WARNING("Could not lock scanned out buffer\n");
+		return;
+	}
+	wayland_buffer_lock(buffer);
+	*entry = buffer;
+}
+
 static int
 target_swap_buffers(struct target *target)
 {
-	target->next_buffer = wld_surface_take(target->surface);
+	/* Composited frames are always synchronized to the vertical blank. */
+	target->screen->planes.primary.async = false;
 	return view_attach(target->view, target->next_buffer);
 }
 
+/**
+ * Adds damage to the target's buffers and shadow, returning the accumulated
+ * damage of the next buffer.
+ */
+static pixman_region32_t *
+target_add_damage(struct target *target, pixman_region32_t *damage)
+{
+	if (target->shadow)
+		pixman_region32_union(&target->shadow_damage, &target->shadow_damage, damage);
+	return wld_surface_damage(target->surface, damage);
+}
+
+static bool
+view_allows_tearing(struct compositor_view *view)
+{
+	switch (view->window ? view->window->tearing_policy : SWC_TEARING_CLIENT) {
+	case SWC_TEARING_NEVER:
+		return false;
+	case SWC_TEARING_ALWAYS:
+		return true;
+	default:
+		return view->surface->state.tearing;
+	}
+}
+
+/**
+ * Flips the view's buffer directly onto the target's screen, skipping
+ * composition.
+ */
+static int
+target_scanout(struct target *target, struct compositor_view *view)
+{
+	int ret;
+
+	target->screen->planes.primary.async = view_allows_tearing(view);
+	if ((ret = view_attach(target->view, view->buffer)) < 0)
+		return ret;
+
+	/* The buffer that was last composited stays on screen until the flip
+	 * completes, at which point it is released in handle_screen_frame. The
+	 * client buffer replacing it is locked once the flip is queued. */
+	target->next_buffer = NULL;
+	return 0;
+}
+
+static void
+handle_repaint(void *data)
+{
+	struct target *target = data;
+
+	target->repaint_idle = NULL;
+	target->repaint_scheduled = false;
+
+	/* Content latched by this repaint must not be reported as part of the
+	 * previous frame. */
+	wl_event_source_timer_update(target->frame_timer, 0);
+	target_send_frame(target);
+	perform_update(target->mask);
+}
+
+static int
+handle_repaint_timer(void *data)
+{
+	handle_repaint(data);
+	return 0;
+}
+
+/**
+ * Schedules a repaint of the target's screen for the repaint margin before
+ * the next vertical blank, or immediately if that time has passed, the
+ * screen has been idle for longer than a refresh cycle, or the screen's
+ * refresh follows a scanned out client.
+ */
+static void
+target_schedule_repaint(struct target *target)
+{
+	uint32_t delay;
+
+	if (target->repaint_scheduled)
+		return;
+
+	delay = target_time_until_vblank(target, compositor.repaint_margin * 1000);
+	if (delay > 0)
+		wl_event_source_timer_update(target->repaint_timer, delay);
+	else if (!(target->repaint_idle = wl_event_loop_add_idle(swc.event_loop, &handle_repaint, target)))
+		return;
+	target->repaint_scheduled = true;
+}
+
 static struct target *
 target_new(struct screen *screen)
 {
 	struct target *target;
 	struct swc_rectangle *geom = &screen->base.geometry;
+	struct plane *plane = screen->planes.primary.plane;
+	uint32_t flags = WLD_DRM_FLAG_SCANOUT;
 
 	if (!(target = malloc(sizeof(*target))))
 		goto error0;
 
-	target->surface = wld_create_surface(swc.drm->context, geom->width, geom->height, WLD_FORMAT_XRGB8888, WLD_DRM_FLAG_SCANOUT);
+	/* Tiled framebuffers need less memory bandwidth to scan out. wld picks
+	 * the layout itself, so this is all we can ask for. */
+	if (plane && plane_supports_tiling(plane, WLD_FORMAT_XRGB8888))
+		flags |= WLD_DRM_FLAG_TILED;
+	target->surface = wld_create_surface(swc.drm->context, geom->width, geom->height, WLD_FORMAT_XRGB8888, flags);
 
 	if (!target->surface)
 		goto error1;
 
+	target->repaint_timer = wl_event_loop_add_timer(swc.event_loop, &handle_repaint_timer, target);
+
+	if (!target->repaint_timer)
+		goto error2;
+
+	target->frame_timer = wl_event_loop_add_timer(swc.event_loop, &handle_frame_timer, target);
+
+	if (!target->frame_timer)
+		goto error3;
+
+	target->shadow = NULL;
+	pixman_region32_init_rect(&target->shadow_damage, 0, 0, geom->width, geom->height);
+	if (compositor.shadow && !(target->shadow = malloc(geom->width * geom->height * 4)))
+		WARNING("Could not allocate shadow buffer\n");
+
 	target->view = &screen->planes.primary.view;
 	target->view_handler.impl = &screen_view_handler;
 	wl_list_insert(&target->view->handlers, &target->view_handler.link);
+	target->next_buffer = NULL;
 	target->current_buffer = NULL;
 	target->mask = screen_mask(screen);
+	target->scanout = false;
+	wl_array_init(&target->next_locks);
+	wl_array_init(&target->current_locks);
+	target->screen = screen;
+	target->last_frame = 0;
+	target->repaint_scheduled = false;
+	target->repaint_idle = NULL;
+	target->frame_pending = false;
+	target->frame_info_valid = false;
 
 	target->screen_destroy_listener.notify = &handle_screen_destroy;
 	wl_signal_add(&screen->destroy_signal, &target->screen_destroy_listener);
 
 	return target;
 
+error3:
+	wl_event_source_remove(target->repaint_timer);
+error2:
+	wld_destroy_surface(target->surface);
 error1:
 	free(target);
 error0:
@@ -178,40 +511,188 @@ error0:
 
 /* Rendering {{{ */
 
+/**
+ * Calculates the regions of the target covered by the view's contents and
+ * border that need to be repainted for the given damage.
+ */
 static void
-repaint_view(struct wld_renderer *renderer, struct target *target, struct compositor_view *view, pixman_region32_t *damage)
+repaint_regions(struct target *target, struct compositor_view *view, pixman_region32_t *damage, bool planes,
+                pixman_region32_t *view_damage, pixman_region32_t *border_damage)
 {
-	pixman_region32_t view_region, view_damage, border_damage, view_clip;
+	pixman_region32_t view_region, view_clip;
 	const struct swc_rectangle *geom = &view->base.geometry, *target_geom = &target->view->geometry;
 	int dx = geom->x - target_geom->x;
 	int dy = geom->y - target_geom->y;
 
-	if (!view->base.buffer)
-		return;
-
 	pixman_region32_init_rect(&view_region, dx, dy, geom->width, geom->height);
 	if (view->background) {
-		pixman_region32_init_rect(&view_damage, dx, dy, geom->width, geom->height);
+		pixman_region32_init_rect(view_damage, dx, dy, geom->width, geom->height);
 	} else {
-		pixman_region32_init_with_extents(&view_damage, &view->extents);
-		pixman_region32_translate(&view_damage, -target_geom->x, -target_geom->y);
+		pixman_region32_init_with_extents(view_damage, &view->extents);
+		pixman_region32_translate(view_damage, -target_geom->x, -target_geom->y);
 	}
-	pixman_region32_init(&border_damage);
+	pixman_region32_init(border_damage);
 	pixman_region32_init(&view_clip);
 	pixman_region32_copy(&view_clip, &view->clip);
 	pixman_region32_translate(&view_clip, -target_geom->x, -target_geom->y);
 
-	pixman_region32_intersect(&view_damage, &view_damage, damage);
-	pixman_region32_subtract(&view_damage, &view_damage, &view_clip);
-	pixman_region32_subtract(&border_damage, &view_damage, &view_region);
-	pixman_region32_intersect(&view_damage, &view_damage, &view_region);
+	pixman_region32_intersect(view_damage, view_damage, damage);
+	pixman_region32_subtract(view_damage, view_damage, &view_clip);
+	pixman_region32_subtract(border_damage, view_damage, &view_region);
+	pixman_region32_intersect(view_damage, view_damage, &view_region);
 
 	pixman_region32_fini(&view_region);
 	pixman_region32_fini(&view_clip);
 
-	if (pixman_region32_not_empty(&view_damage)) {
-		pixman_region32_translate(&view_damage, -dx, -dy);
-		wld_copy_region(renderer, view->buffer, dx, dy, &view_damage);
+	/* Views on an overlay plane only need their border drawn. */
+	if (planes && view->plane)
+		pixman_region32_clear(view_damage);
+}
+
+static pixman_format_code_t
+format_wld_to_pixman(uint32_t format)
+{
+	switch (format) {
+	case WLD_FORMAT_XRGB8888:
+		return PIXMAN_x8r8g8b8;
+	case WLD_FORMAT_ARGB8888:
+		return PIXMAN_a8r8g8b8;
+	default:
+		return 0;
+	}
+}
+
+static pixman_image_t *
+create_image(struct wld_buffer *buffer, pixman_format_code_t format)
+{
+	return pixman_image_create_bits_no_clear(format, buffer->width, buffer->height, buffer->map, buffer->pitch);
+}
+
+/**
+ * Creates an image of the buffer the view is drawn from, limited to the size
+ * of its client buffer. Beyond that, the contents of a proxy are undefined.
+ */
+static pixman_image_t *
+create_view_image(struct compositor_view *view, pixman_format_code_t format)
+{
+	return pixman_image_create_bits_no_clear(format, view->base.buffer->width, view->base.buffer->height,
+	                                         view->buffer->map, view->buffer->pitch);
+}
+
+/**
+ * Sets up the transform from view to buffer coordinates of a view whose
+ * buffer is cropped or scaled, along with the filter to sample it with.
+ *
+ * @return Whether or not the view needs a transform.
+ */
+static bool
+view_get_transform(struct compositor_view *view, pixman_transform_t *transform, pixman_filter_t *filter)
+{
+	const struct swc_rectangle *geom = &view->base.geometry;
+	wl_fixed_t x, y, width, height;
+	pixman_fixed_t sx, sy;
+
+	if (view->solid || !geom->width || !geom->height || !surface_get_source(view->surface, &x, &y, &width, &height))
+		return false;
+
+	sx = pixman_double_to_fixed(wl_fixed_to_double(width) / geom->width);
+	sy = pixman_double_to_fixed(wl_fixed_to_double(height) / geom->height);
+	pixman_transform_init_scale(transform, sx, sy);
+	pixman_transform_translate(transform, NULL, x * 256, y * 256);
+	*filter = sx == pixman_fixed_1 && sy == pixman_fixed_1 ? PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR;
+
+	return true;
+}
+
+static void
+set_image_transform(pixman_image_t *image, pixman_transform_t *transform, pixman_filter_t filter)
+{
+	pixman_image_set_transform(image, transform);
+	pixman_image_set_filter(image, filter, NULL, 0);
+	pixman_image_set_repeat(image, PIXMAN_REPEAT_PAD);
+}
+
+/**
+ * Returns the view's content scaled to the view's size, updating it if the
+ * buffer changed since, or NULL if it could not be scaled.
+ */
+static struct wld_buffer *
+get_scaled_buffer(struct compositor_view *view, pixman_transform_t *transform, pixman_filter_t filter)
+{
+	const struct swc_rectangle *geom = &view->base.geometry;
+	struct wld_buffer *buffer = view->buffer;
+	pixman_format_code_t format;
+	pixman_image_t *src = NULL, *dst = NULL;
+
+	if (!(format = format_wld_to_pixman(buffer->format)))
+		return NULL;
+
+	if (view->scaled && !buffer_pool_fits(view->scaled, geom->width, geom->height, buffer->format)) {
+		buffer_pool_put(view->scaled);
+		view->scaled = NULL;
+	}
+	if (!view->scaled) {
+		if (!(view->scaled = buffer_pool_get(geom->width, geom->height, buffer->format)))
+			return NULL;
+		view->scaled_dirty = true;
+	}
+	if (!view->scaled_dirty)
+		return view->scaled;
+
+	if (!wld_map(buffer))
+		return NULL;
+	if (wld_map(view->scaled)) {
+		dmabuf_begin_read(buffer);
+		if ((src = create_view_image(view, format)) && (dst = create_image(view->scaled, format))) {
+			set_image_transform(src, transform, filter);
+			pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, dst, 0, 0, 0, 0, 0, 0, geom->width, geom->height);
+			view->scaled_dirty = false;
+		}
+		if (src)
+			pixman_image_unref(src);
+		if (dst)
+			pixman_image_unref(dst);
+		dmabuf_end_read(buffer);
+		wld_unmap(view->scaled);
+	}
+	wld_unmap(buffer);
+
+	return view->scaled_dirty ? NULL : view->scaled;
+}
+
+static void
+release_scaled_buffer(struct compositor_view *view)
+{
+	if (!view->scaled)
+		return;
+	buffer_pool_put(view->scaled);
+	view->scaled = NULL;
+}
+
+static void
+repaint_view(struct wld_renderer *renderer, struct target *target, struct compositor_view *view, pixman_region32_t *damage, bool planes)
+{
+	pixman_region32_t view_damage, border_damage;
+	const struct swc_rectangle *geom = &view->base.geometry, *target_geom = &target->view->geometry;
+	struct wld_buffer *buffer, *scaled;
+	pixman_transform_t transform;
+	pixman_filter_t filter;
+
+	if (!view->buffer)
+		return;
+
+	repaint_regions(target, view, damage, planes, &view_damage, &border_damage);
+
+	if (pixman_region32_not_empty(&view_damage) && view->solid) {
+		wld_fill_region(renderer, view->solid_color, &view_damage);
+	} else if (pixman_region32_not_empty(&view_damage)) {
+		buffer = view->buffer;
+		if (view_get_transform(view, &transform, &filter) && (scaled = get_scaled_buffer(view, &transform, filter)))
+			buffer = scaled;
+		pixman_region32_translate(&view_damage, target_geom->x - geom->x, target_geom->y - geom->y);
+		dmabuf_begin_read(buffer);
+		wld_copy_region(renderer, buffer, geom->x - target_geom->x, geom->y - target_geom->y, &view_damage);
+		dmabuf_end_read(buffer);
 	}
 
 	pixman_region32_fini(&view_damage);
@@ -223,49 +704,391 @@ repaint_view(struct wld_renderer *renderer, struct target *target, struct compos
 	pixman_region32_fini(&border_damage);
 }
 
+/* Parallel Rendering {{{ */
+
+/* A view to be painted by the render threads, with its buffer mapped unless
+ * it is solid. */
+struct band_view {
+	struct compositor_view *view;
+	pixman_format_code_t format;
+
+	/* For buffers that are cropped or scaled, the transform from view to
+	 * buffer coordinates. */
+	bool transformed;
+	pixman_transform_t transform;
+	pixman_filter_t filter;
+};
+
+struct band_repaint {
+	struct target *target;
+	/* The memory the bands are composited into: the target buffer or its
+	 * shadow. */
+	void *data;
+	uint32_t pitch;
+	pixman_region32_t *damage, *base_damage;
+	struct band_view *views;
+	unsigned num_views;
+	uint32_t band_height;
+
+	/* When compositing into the shadow, the target buffer and the region of
+	 * it to be copied from the shadow. */
+	struct wld_buffer *buffer;
+	pixman_region32_t *copy;
+};
+
+/**
+ * Copies the region from the shadow to the target buffer a row at a time, so
+ * that the buffer is only written sequentially and never read.
+ */
+static void
+copy_shadow(struct band_repaint *repaint, pixman_region32_t *region)
+{
+	pixman_box32_t *boxes;
+	int i, num_boxes;
+	int32_t y;
+	size_t size;
+
+	boxes = pixman_region32_rectangles(region, &num_boxes);
+	for (i = 0; i < num_boxes; ++i) {
+		size = (boxes[i].x2 - boxes[i].x1) * 4;
+		for (y = boxes[i].y1; y < boxes[i].y2; ++y) {
+			memcpy((char *)repaint->buffer->map + y * repaint->buffer->pitch + boxes[i].x1 * 4,
+			       (char *)repaint->data + y * repaint->pitch + boxes[i].x1 * 4, size);
+		}
+	}
+}
+
+static void
+fill_region(pixman_image_t *image, uint32_t color, pixman_region32_t *region)
+{
+	pixman_color_t pixman_color = {
+		.alpha = (color >> 24 & 0xff) * 0x101,
+		.red = (color >> 16 & 0xff) * 0x101,
+		.green = (color >> 8 & 0xff) * 0x101,
+		.blue = (color & 0xff) * 0x101,
+	};
+	pixman_box32_t *boxes;
+	int num_boxes;
+
+	boxes = pixman_region32_rectangles(region, &num_boxes);
+	pixman_image_fill_boxes(PIXMAN_OP_SRC, image, &pixman_color, num_boxes, boxes);
+}
+
+/**
+ * Repaints one horizontal band of the target. Each band is drawn through its
+ * own pixman images, since those are not safe to share between threads.
+ */
+static void
+repaint_band(void *data, unsigned index)
+{
+	struct band_repaint *repaint = data;
+	const struct swc_rectangle *target_geom = &repaint->target->view->geometry, *geom;
+	pixman_region32_t band, damage, view_damage, border_damage;
+	pixman_image_t *dst, *src;
+	pixman_box32_t *boxes;
+	uint32_t y = index * repaint->band_height;
+	struct band_view *band_view;
+	int i, num_boxes;
+
+	if (!(dst = pixman_image_create_bits_no_clear(PIXMAN_x8r8g8b8, target_geom->width, target_geom->height, repaint->data, repaint->pitch)))
+		return;
+
+	pixman_region32_init_rect(&band, 0, y, target_geom->width, MIN(repaint->band_height, target_geom->height - y));
+	pixman_region32_init(&damage);
+	pixman_region32_intersect(&damage, repaint->base_damage, &band);
+	if (pixman_region32_not_empty(&damage))
+		fill_region(dst, 0xff1b1b1b, &damage);
+
+	/* Like the damage passed to repaint_view, this is in global coordinates. */
+	pixman_region32_copy(&damage, &band);
+	pixman_region32_translate(&damage, target_geom->x, target_geom->y);
+	pixman_region32_intersect(&damage, &damage, repaint->damage);
+
+	for (band_view = repaint->views; band_view < repaint->views + repaint->num_views; ++band_view) {
+		geom = &band_view->view->base.geometry;
+		repaint_regions(repaint->target, band_view->view, &damage, true, &view_damage, &border_damage);
+		pixman_region32_intersect(&view_damage, &view_damage, &band);
+		pixman_region32_intersect(&border_damage, &border_damage, &band);
+
+		if (pixman_region32_not_empty(&view_damage) && band_view->view->solid) {
+			fill_region(dst, band_view->view->solid_color, &view_damage);
+		} else if (pixman_region32_not_empty(&view_damage) && (src = create_view_image(band_view->view, band_view->format))) {
+			if (band_view->transformed)
+				set_image_transform(src, &band_view->transform, band_view->filter);
+			boxes = pixman_region32_rectangles(&view_damage, &num_boxes);
+			for (i = 0; i < num_boxes; ++i) {
+				pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, dst,
+				                         boxes[i].x1 - (geom->x - target_geom->x), boxes[i].y1 - (geom->y - target_geom->y),
+				                         0, 0, boxes[i].x1, boxes[i].y1,
+				                         boxes[i].x2 - boxes[i].x1, boxes[i].y2 - boxes[i].y1);
+			}
+			pixman_image_unref(src);
+		}
+		if (pixman_region32_not_empty(&border_damage))
+			fill_region(dst, band_view->view->border.color, &border_damage);
+
+		pixman_region32_fini(&view_damage);
+		pixman_region32_fini(&border_damage);
+	}
+
+	if (repaint->copy) {
+		pixman_region32_intersect(&damage, repaint->copy, &band);
+		copy_shadow(repaint, &damage);
+	}
+
+	pixman_region32_fini(&damage);
+	pixman_region32_fini(&band);
+	pixman_image_unref(dst);
+}
+
+/**
+ * Repaints the target in bands spread across the render threads, drawing
+ * directly into the mapped buffers with pixman. If the target has a shadow,
+ * the damage is composited there and the copy region is then copied to the
+ * target buffer.
+ *
+ * @return Whether or not the views' buffers could all be used.
+ */
+static bool
+renderer_repaint_pixman(struct target *target, struct wld_buffer *buffer, pixman_region32_t *damage, pixman_region32_t *base_damage,
+                        pixman_region32_t *copy, struct wl_list *views)
+{
+	struct compositor_view *view;
+	struct band_repaint repaint = {
+		.target = target,
+		.damage = damage,
+		.base_damage = base_damage,
+	};
+	uint32_t height = target->view->geometry.height, num_bands;
+	unsigned num_mapped = 0, i;
+	bool ret = false;
+
+	if (buffer->format != WLD_FORMAT_XRGB8888 || !wld_map(buffer))
+		return false;
+
+	if (target->shadow) {
+		repaint.data = target->shadow;
+		repaint.pitch = target->view->geometry.width * 4;
+		repaint.buffer = buffer;
+		repaint.copy = copy;
+	} else {
+		repaint.data = buffer->map;
+		repaint.pitch = buffer->pitch;
+	}
+
+	wl_list_for_each (view, views, link)
+		++repaint.num_views;
+	if (!(repaint.views = malloc(MAX(repaint.num_views, 1) * sizeof(repaint.views[0]))))
+		goto done;
+
+	repaint.num_views = 0;
+	wl_list_for_each_reverse (view, views, link) {
+		if (!view->visible || !(view->base.screens & target->mask) || !view->buffer)
+			continue;
+		if (view->solid) {
+			repaint.views[num_mapped].format = 0;
+			repaint.views[num_mapped].transformed = false;
+			repaint.views[num_mapped++].view = view;
+			continue;
+		}
+		if (!(repaint.views[num_mapped].format = format_wld_to_pixman(view->buffer->format)) || !wld_map(view->buffer))
+			goto done;
+		repaint.views[num_mapped].transformed = view_get_transform(view, &repaint.views[num_mapped].transform,
+		                                                           &repaint.views[num_mapped].filter);
+		dmabuf_begin_read(view->buffer);
+		repaint.views[num_mapped++].view = view;
+	}
+	repaint.num_views = num_mapped;
+
+	/* Several bands per thread even out uneven damage. */
+	num_bands = MIN(compositor.render_threads * 4, MAX(height / 16, 1));
+	repaint.band_height = (height + num_bands - 1) / num_bands;
+	num_bands = (height + repaint.band_height - 1) / repaint.band_height;
+	if (compositor.render_pool) {
+		thread_pool_run(compositor.render_pool, &repaint_band, &repaint, num_bands);
+	} else {
+		for (i = 0; i < num_bands; ++i)
+			repaint_band(&repaint, i);
+	}
+	ret = true;
+
+done:
+	for (i = 0; i < num_mapped; ++i) {
+		if (repaint.views[i].view->solid)
+			continue;
+		dmabuf_end_read(repaint.views[i].view->buffer);
+		wld_unmap(repaint.views[i].view->buffer);
+	}
+	free(repaint.views);
+	wld_unmap(buffer);
+	return ret;
+}
+
+/* }}} */
+
+/**
+ * Repaints the damaged region of the target buffer. If the target has a
+ * shadow, only its own damage is composited and the rest of the copy region,
+ * which is in target coordinates, comes from the shadow.
+ */
+static void
+renderer_repaint(struct target *target, struct wld_buffer *buffer, pixman_region32_t *damage, pixman_region32_t *base_damage,
+                 pixman_region32_t *copy, struct wl_list *views)
+{
+	struct compositor_view *view;
+	const struct swc_rectangle *geom = &target->view->geometry;
+
+	DEBUG("Rendering to target { x: %d, y: %d, w: %u, h: %u }\n",
+	      target->view->geometry.x, target->view->geometry.y,
+	      target->view->geometry.width, target->view->geometry.height);
+
+	pixman_region32_translate(base_damage, -target->view->geometry.x, -target->view->geometry.y);
+	if (compositor.pixman && renderer_repaint_pixman(target, buffer, damage, base_damage, copy, views))
+		return;
+
+	if (target->shadow) {
+		/* The shadow is not kept up to date by the wld renderer, so it has
+		 * to be redrawn from scratch, and the buffer cannot rely on it. */
+		pixman_region32_union_rect(&target->shadow_damage, &target->shadow_damage, 0, 0, geom->width, geom->height);
+		pixman_region32_union_rect(damage, damage, geom->x, geom->y, geom->width, geom->height);
+		pixman_region32_subtract(base_damage, damage, &compositor.opaque);
+		pixman_region32_translate(base_damage, -geom->x, -geom->y);
+	}
+
+	wld_set_target_buffer(swc.drm->renderer, buffer);
+	if (pixman_region32_not_empty(base_damage))
+		wld_fill_region(swc.drm->renderer, 0xff1b1b1b, base_damage);
+
+	wl_list_for_each_reverse (view, views, link) {
+		if (view->visible && view->base.screens & target->mask) {
+			repaint_view(swc.drm->renderer, target, view, damage, true);
+		}
+	}
+
+	wld_flush(swc.drm->renderer);
+}
+
+/**
+ * Returns whether the view is drawn from a copy of its client buffer, rather
+ * than that buffer or one sharing its memory.
+ */
+static bool
+has_proxy(struct compositor_view *view)
+{
+	if (!view->buffer || view->buffer == view->base.buffer || view->solid)
+		return false;
+	return view->buffer != shm_get_drm_buffer(view->base.buffer);
+}
+
+static size_t
+proxy_size(struct compositor_view *view)
+{
+	return has_proxy(view) ? (size_t)view->buffer->pitch * view->buffer->height : 0;
+}
+
+/**
+ * Returns whether the view's proxy can be dropped while it is hidden, to be
+ * rebuilt from its client buffer once it is shown again. That is not the case
+ * if the buffer was released early, since its client may have reused it.
+ */
+static bool
+can_reclaim_proxy(struct compositor_view *view)
+{
+	return has_proxy(view) && !view->surface->state.buffer_released;
+}
+
+static void
+reclaim_proxy(struct compositor_view *view)
+{
+	DEBUG("Reclaiming proxy of hidden view\n");
+	buffer_pool_put(view->buffer);
+	view->buffer = NULL;
+	view->proxy_reclaimed = true;
+}
+
+/**
+ * Drops the proxies of views that have been hidden for a while, and if the
+ * remaining proxies take more memory than allowed, those of the views hidden
+ * longest.
+ */
 static void
-renderer_repaint(struct target *target, pixman_region32_t *damage, pixman_region32_t *base_damage, struct wl_list *views)
+reclaim_proxies(void)
 {
-	struct compositor_view *view;
-
-	DEBUG("Rendering to target { x: %d, y: %d, w: %u, h: %u }\n",
-	      target->view->geometry.x, target->view->geometry.y,
-	      target->view->geometry.width, target->view->geometry.height);
+	struct compositor_view *view, *oldest;
+	uint32_t now = get_time(), hidden, next = 0;
+	size_t total = 0;
 
-	wld_set_target_surface(swc.drm->renderer, target->surface);
-	if (pixman_region32_not_empty(base_damage)) {
-		pixman_region32_translate(base_damage, -target->view->geometry.x, -target->view->geometry.y);
-		wld_fill_region(swc.drm->renderer, 0xff1b1b1b, base_damage);
+	wl_list_for_each (view, &compositor.views, link) {
+		if (!has_proxy(view))
+			continue;
+		if (!view->visible && can_reclaim_proxy(view)) {
+			hidden = now - view->hide_time;
+			if (hidden >= PROXY_RECLAIM_DELAY) {
+				reclaim_proxy(view);
+				continue;
+			}
+			if (!next || PROXY_RECLAIM_DELAY - hidden < next)
+				next = PROXY_RECLAIM_DELAY - hidden;
+		}
+		total += proxy_size(view);
 	}
 
-	wl_list_for_each_reverse (view, views, link) {
-		if (view->visible && view->base.screens & target->mask) {
-			repaint_view(swc.drm->renderer, target, view, damage);
+	while (total > PROXY_BUDGET) {
+		oldest = NULL;
+		wl_list_for_each (view, &compositor.views, link) {
+			if (!view->visible && can_reclaim_proxy(view) && (!oldest || (int32_t)(view->hide_time - oldest->hide_time) < 0))
+				oldest = view;
 		}
+		if (!oldest)
+			break;
+		total -= proxy_size(oldest);
+		reclaim_proxy(oldest);
 	}
 
-	wld_flush(swc.drm->renderer);
+	if (next && compositor.reclaim_timer)
+		wl_event_source_timer_update(compositor.reclaim_timer, next);
+}
+
+static int
+handle_reclaim_timer(void *data)
+{
+	reclaim_proxies();
+	return 0;
 }
 
 static int
 renderer_attach(struct compositor_view *view, struct wld_buffer *client_buffer)
 {
-	struct wld_buffer *buffer;
-	bool was_proxy = view->buffer != view->base.buffer;
-	bool needs_proxy = view->background || (client_buffer && !(wld_capabilities(swc.drm->renderer, client_buffer) & WLD_CAPABILITY_READ));
-	bool resized = view->buffer && client_buffer && (view->buffer->width != client_buffer->width || view->buffer->height != client_buffer->height);
+	struct wld_buffer *buffer, *shared = NULL;
+	bool was_proxy, was_shared, needs_proxy, keep_proxy, solid;
+	uint32_t color;
+
+	/* The view is set up with its latest buffer once it is shown again. */
+	if (view->proxy_reclaimed)
+		return 0;
+
+	solid = client_buffer && single_pixel_buffer_get_color(client_buffer, &color);
+	was_proxy = has_proxy(view);
+	was_shared = view->buffer && !was_proxy && view->buffer != view->base.buffer;
+	needs_proxy = !solid && client_buffer && !(wld_capabilities(swc.drm->renderer, client_buffer) & WLD_CAPABILITY_READ)
+	              && !(shared = shm_get_drm_buffer(client_buffer));
+	keep_proxy = was_proxy && needs_proxy && client_buffer
+	             && buffer_pool_fits(view->buffer, client_buffer->width, client_buffer->height, client_buffer->format);
 
 	if (client_buffer) {
 		if (needs_proxy) {
-			if (!was_proxy || resized) {
+			if (!keep_proxy) {
 				DEBUG("Creating a proxy buffer\n");
-				buffer = wld_create_buffer(swc.drm->context, client_buffer->width, client_buffer->height, client_buffer->format, WLD_FLAG_MAP);
+				buffer = buffer_pool_get(client_buffer->width, client_buffer->height, client_buffer->format);
 
 				if (!buffer)
 					return -ENOMEM;
 			} else {
 				buffer = view->buffer;
 			}
+		} else if (shared) {
+			wld_buffer_reference(shared);
+			buffer = shared;
 		} else {
 			buffer = client_buffer;
 		}
@@ -273,46 +1096,97 @@ renderer_attach(struct compositor_view *view, struct wld_buffer *client_buffer)
 		buffer = NULL;
 	}
 
-	if (view->buffer && ((!needs_proxy && was_proxy) || (needs_proxy && resized)))
+	if (was_shared)
 		wld_buffer_unreference(view->buffer);
+	else if (was_proxy && !keep_proxy)
+		buffer_pool_put(view->buffer);
 
 	view->buffer = buffer;
+	view->scaled_dirty = true;
+	if (!buffer)
+		release_scaled_buffer(view);
+	view->solid = solid;
+	if (solid)
+		view->solid_color = color;
+	if (buffer && needs_proxy && !keep_proxy)
+		reclaim_proxies();
 
 	return 0;
 }
 
+/**
+ * Rebuilds the proxy of a view that is shown again from its client buffer,
+ * which was not released while the proxy was reclaimed.
+ */
+static void
+restore_proxy(struct compositor_view *view)
+{
+	struct wld_buffer *buffer = view->base.buffer;
+
+	view->proxy_reclaimed = false;
+	if (renderer_attach(view, buffer) < 0 || !buffer)
+		return;
+	pixman_region32_union_rect(&view->surface->state.damage, &view->surface->state.damage, 0, 0, buffer->width, buffer->height);
+}
+
+static void
+flush_proxy(struct compositor_view *view, pixman_region32_t *damage)
+{
+	dmabuf_begin_read(view->base.buffer);
+	wld_set_target_buffer(swc.shm->renderer, view->buffer);
+	wld_copy_region(swc.shm->renderer, view->base.buffer, 0, 0, damage);
+	wld_flush(swc.shm->renderer);
+	dmabuf_end_read(view->base.buffer);
+	view->proxy_stale = false;
+}
+
+/**
+ * Brings a proxy that went stale up to date with all of its client buffer.
+ */
+static void
+refresh_proxy(struct compositor_view *view)
+{
+	pixman_region32_t damage;
+
+	view->proxy_stale = false;
+	if (!has_proxy(view))
+		return;
+	pixman_region32_init_rect(&damage, 0, 0, view->base.buffer->width, view->base.buffer->height);
+	flush_proxy(view, &damage);
+	pixman_region32_fini(&damage);
+}
+
 static void
 renderer_flush_view(struct compositor_view *view)
 {
-	if (view->buffer == view->base.buffer)
+	pixman_region32_t damage;
+	wl_fixed_t x, y, width, height;
+
+	view->scaled_dirty = true;
+	if (!view->buffer || view->solid)
 		return;
 
-	if (view->background) {
-		bool dst_mapped, src_mapped;
-		dst_mapped = wld_map(view->buffer);
-		src_mapped = wld_map(view->base.buffer);
-		if (dst_mapped && src_mapped) {
-			uint8_t *d = view->buffer->map;
-			uint8_t *s = view->base.buffer->map;
-			uint32_t width = view->base.buffer->width;
-			uint32_t height = view->base.buffer->height;
-			uint32_t dpitch = view->buffer->pitch;
-			uint32_t spitch = view->base.buffer->pitch;
-			for (uint32_t i = 0; i < height; ++i) {
-				memcpy(d, s, width * 4);
-				d += dpitch;
-				s += spitch;
-			}
-		}
-		if (dst_mapped)
-			wld_unmap(view->buffer);
-		if (src_mapped)
-			wld_unmap(view->base.buffer);
-	} else {
-		wld_set_target_buffer(swc.shm->renderer, view->buffer);
-		wld_copy_region(swc.shm->renderer, view->base.buffer, 0, 0, &view->surface->state.damage);
-		wld_flush(swc.shm->renderer);
+	/* The damage is in surface coordinates, which only match those of a
+	 * buffer that is neither cropped nor scaled. */
+	pixman_region32_init(&damage);
+	if (surface_get_source(view->surface, &x, &y, &width, &height))
+		pixman_region32_union_rect(&damage, &damage, 0, 0, view->base.buffer->width, view->base.buffer->height);
+	else
+		pixman_region32_copy(&damage, &view->surface->state.damage);
+	dmabuf_damage(view->base.buffer, &damage);
+
+	/* A YUV buffer scanned out by an overlay plane is only converted once
+	 * it has to be composited again. */
+	if (view->plane && has_proxy(view)) {
+		view->proxy_stale = true;
+	} else if (has_proxy(view)) {
+		flush_proxy(view, &damage);
+
+		/* Only the proxy is read from now on, so the client may reuse
+		 * its buffer right away. */
+		surface_release_buffer(view->surface);
 	}
+	pixman_region32_fini(&damage);
 }
 
 /* }}} */
@@ -344,6 +1218,23 @@ damage_view(struct compositor_view *view)
 	view->border.damaged = true;
 }
 
+/**
+ * Marks the clip regions of the view and all views below it as out of date.
+ */
+static void
+invalidate_clip(struct compositor_view *view)
+{
+	view->clip_dirty = true;
+}
+
+static void
+update_grid(struct compositor_view *view)
+{
+	view->grid_item.area = view->base.geometry;
+	if (!grid_insert(&compositor.grid, &view->grid_item))
+		WARNING("Could not add view to input grid\n");
+}
+
 static void
 update_extents(struct compositor_view *view)
 {
@@ -359,18 +1250,20 @@ update_extents(struct compositor_view *view)
 static void
 schedule_updates(uint32_t screens)
 {
-	if (compositor.scheduled_updates == 0)
-		wl_event_loop_add_idle(swc.event_loop, &perform_update, NULL);
+	struct screen *screen;
+	struct target *target;
 
-	if (screens == -1) {
-		struct screen *screen;
+	wl_list_for_each (screen, &swc.screens, link) {
+		if (!(screens & screen_mask(screen)))
+			continue;
+		compositor.scheduled_updates |= screen_mask(screen);
 
-		screens = 0;
-		wl_list_for_each (screen, &swc.screens, link)
-			screens |= screen_mask(screen);
+		/* Screens waiting on a page flip are scheduled when it completes. */
+		if (compositor.pending_flips & screen_mask(screen))
+			continue;
+		if ((target = target_get(screen)))
+			target_schedule_repaint(target);
 	}
-
-	compositor.scheduled_updates |= screens;
 }
 
 static bool
@@ -392,6 +1285,7 @@ attach(struct view *base, struct wld_buffer *buffer)
 	struct compositor_view *view = (void *)base;
 	pixman_box32_t old_extents;
 	pixman_region32_t old, new, both;
+	uint32_t width, height;
 	int ret;
 
 	if ((ret = renderer_attach(view, buffer)) < 0)
@@ -401,7 +1295,17 @@ attach(struct view *base, struct wld_buffer *buffer)
 	 * visible on. */
 	update(&view->base);
 
-	if (view_set_size_from_buffer(&view->base, buffer)) {
+	/* A solid view's color may have changed anywhere, not just in the single
+	 * damaged pixel. Backgrounds keep the size of their screen. */
+	if (view->solid) {
+		invalidate_clip(view);
+		if (view->visible)
+			damage_view(view);
+	}
+
+	/* The surface size accounts for the viewport, if any. */
+	surface_get_size(view->surface, &width, &height);
+	if (!(view->solid && view->background) && view_set_size(&view->base, width, height)) {
 		/* The view was resized. */
 		old_extents = view->extents;
 		update_extents(view);
@@ -421,6 +1325,8 @@ attach(struct view *base, struct wld_buffer *buffer)
 			pixman_region32_fini(&new);
 			pixman_region32_fini(&both);
 
+			invalidate_clip(view);
+			update_grid(view);
 			view_update_screens(&view->base);
 			update(&view->base);
 		}
@@ -445,7 +1351,9 @@ move(struct view *base, int32_t x, int32_t y)
 		if (view->visible) {
 			/* Assume worst-case no clipping until we draw the next frame (in case the
 			 * surface gets moved again before that). */
-			pixman_region32_init(&view->clip);
+			pixman_region32_clear(&view->clip);
+			invalidate_clip(view);
+			update_grid(view);
 
 			view_update_screens(&view->base);
 			damage_below_view(view);
@@ -475,6 +1383,11 @@ compositor_create_view(struct surface *surface)
 	view_initialize(&view->base, &view_impl);
 	view->surface = surface;
 	view->buffer = NULL;
+	view->scaled = NULL;
+	view->scaled_dirty = false;
+	view->proxy_reclaimed = false;
+	view->proxy_stale = false;
+	view->hide_time = 0;
 	view->window = NULL;
 	view->parent = NULL;
 	view->visible = false;
@@ -486,10 +1399,17 @@ compositor_create_view(struct surface *surface)
 	view->border.color = 0x000000;
 	view->border.damaged = false;
 	pixman_region32_init(&view->clip);
+	pixman_region32_init(&view->occlusion);
+	view->clip_dirty = false;
+	view->grid_item.order = compositor.top_order--;
+	view->grid_item.inserted = false;
 	wl_signal_init(&view->destroy_signal);
 	surface_set_view(surface, &view->base);
 
 	view->background = false;
+	view->solid = false;
+	view->solid_color = 0;
+	view->plane = NULL;
 	wl_list_insert(&compositor.views, &view->link);
 
 	return view;
@@ -498,11 +1418,23 @@ compositor_create_view(struct surface *surface)
 void
 compositor_view_destroy(struct compositor_view *view)
 {
+	struct compositor_view *other;
+
 	wl_signal_emit(&view->destroy_signal, NULL);
 	compositor_view_hide(view);
+	wl_list_for_each (other, &compositor.views, link) {
+		if (other->parent == view)
+			other->parent = NULL;
+	}
 	surface_set_view(view->surface, NULL);
+	renderer_attach(view, NULL);
 	view_finalize(&view->base);
 	pixman_region32_fini(&view->clip);
+	pixman_region32_fini(&view->occlusion);
+
+	/* Pass on the recalculation to the views that were below. */
+	if (view->clip_dirty && view->link.next != &compositor.views)
+		invalidate_clip(wl_container_of(view->link.next, view, link));
 	wl_list_remove(&view->link);
 	free(view);
 }
@@ -513,10 +1445,16 @@ compositor_view(struct view *view)
 	return view->impl == &view_impl ? (struct compositor_view *)view : NULL;
 }
 
+void
+compositor_view_update_opaque(struct compositor_view *view)
+{
+	invalidate_clip(view);
+}
+
 void
 compositor_view_set_parent(struct compositor_view *view, struct compositor_view *parent)
 {
-	view->parent = view;
+	view->parent = parent;
 
 	if (parent->visible)
 		compositor_view_show(view);
@@ -524,6 +1462,59 @@ compositor_view_set_parent(struct compositor_view *view, struct compositor_view
 		compositor_view_hide(view);
 }
 
+/**
+ * Gives the views consecutive orders in the input grid that match their
+ * stacking order.
+ */
+static void
+renumber_views(void)
+{
+	struct compositor_view *view;
+	uint64_t order = compositor.top_order + 1;
+
+	wl_list_for_each (view, &compositor.views, link) {
+		view->grid_item.order = order++;
+		if (view->grid_item.inserted)
+			grid_insert(&compositor.grid, &view->grid_item);
+	}
+	compositor.bottom_order = order;
+}
+
+/**
+ * Moves the view's link in the stacking order to follow the given link.
+ */
+static void
+restack(struct compositor_view *view, struct wl_list *link)
+{
+	/* The views below the old position need their clip recalculated, and
+	 * the view may now cover or be covered by anything it overlaps. */
+	if (view->link.next != &compositor.views)
+		invalidate_clip(wl_container_of(view->link.next, view, link));
+	if (view->visible)
+		pixman_region32_union_rect(&compositor.damage, &compositor.damage, view->extents.x1, view->extents.y1,
+		                           view->extents.x2 - view->extents.x1, view->extents.y2 - view->extents.y1);
+
+	wl_list_remove(&view->link);
+	wl_list_insert(link, &view->link);
+	invalidate_clip(view);
+	renumber_views();
+	update(&view->base);
+}
+
+void
+compositor_view_place_above(struct compositor_view *view, struct compositor_view *sibling)
+{
+	if (view != sibling && sibling->link.prev != &view->link)
+		restack(view, sibling->link.prev);
+}
+
+void
+compositor_view_place_below(struct compositor_view *view, struct compositor_view *sibling)
+{
+	if (view != sibling && sibling->link.next != &view->link)
+		restack(view, &sibling->link);
+}
+
 void
 compositor_view_show(struct compositor_view *view)
 {
@@ -533,16 +1524,21 @@ compositor_view_show(struct compositor_view *view)
 		return;
 
 	view->visible = true;
+	if (view->proxy_reclaimed)
+		restore_proxy(view);
 	view_update_screens(&view->base);
 
 	if (view->background) {
 		wl_list_remove(&view->link);
 		wl_list_insert(compositor.views.prev, &view->link);
+		view->grid_item.order = compositor.bottom_order++;
 	}
+	update_grid(view);
 
 	/* Assume worst-case no clipping until we draw the next frame (in case the
 	 * surface gets moved before that. */
 	pixman_region32_clear(&view->clip);
+	invalidate_clip(view);
 	damage_view(view);
 	update(&view->base);
 
@@ -566,6 +1562,16 @@ compositor_view_hide(struct compositor_view *view)
 
 	view_set_screens(&view->base, 0);
 	view->visible = false;
+	view->hide_time = get_time();
+	invalidate_clip(view);
+	grid_remove(&compositor.grid, &view->grid_item);
+	reclaim_proxies();
+	release_scaled_buffer(view);
+	dmabuf_set_scanout_plane(view->surface, NULL);
+
+	/* The plane is disabled along with the next frame, which composites the
+	 * area the view uncovered. */
+	view->plane = NULL;
 
 	wl_list_for_each (other, &compositor.views, link) {
 		if (other->parent == view)
@@ -607,40 +1613,52 @@ compositor_view_set_border_color(struct compositor_view *view, uint32_t color)
 static void
 calculate_damage(void)
 {
-	struct compositor_view *view;
+	struct compositor_view *view, *above = NULL;
 	struct swc_rectangle *geom;
-	pixman_region32_t surface_opaque, *surface_damage;
+	pixman_region32_t *surface_damage;
+	bool dirty = false;
 
-	pixman_region32_clear(&compositor.opaque);
-	pixman_region32_init(&surface_opaque);
-
-	/* Go through views top-down to calculate clipping regions. */
+	/* Go through views top-down to calculate clipping regions. Those above the
+	 * topmost view with a change in visibility, geometry or opaque region are
+	 * still valid. */
 	wl_list_for_each (view, &compositor.views, link) {
+		dirty = dirty || view->clip_dirty;
+		view->clip_dirty = false;
+
 		if (!view->visible)
 			continue;
 
 		geom = &view->base.geometry;
 
-		/* Clip the surface by the opaque region covering it. */
-		pixman_region32_copy(&view->clip, &compositor.opaque);
-
-		/* Translate the opaque region to global coordinates. */
-		pixman_region32_copy(&surface_opaque, &view->surface->state.opaque);
-		pixman_region32_translate(&surface_opaque, geom->x, geom->y);
-
-		/* Add the surface's opaque region to the accumulated opaque region. */
-		pixman_region32_union(&compositor.opaque, &compositor.opaque, &surface_opaque);
+		if (dirty) {
+			/* Clip the surface by the opaque region covering it. */
+			if (above)
+				pixman_region32_copy(&view->clip, &above->occlusion);
+			else
+				pixman_region32_clear(&view->clip);
+
+			/* Add the surface's opaque region, in global coordinates. */
+			pixman_region32_copy(&view->occlusion, &view->surface->state.opaque);
+			pixman_region32_translate(&view->occlusion, geom->x, geom->y);
+			if (view->solid && view->solid_color >> 24 == 0xff)
+				pixman_region32_union_rect(&view->occlusion, &view->occlusion, geom->x, geom->y, geom->width, geom->height);
+			pixman_region32_union(&view->occlusion, &view->occlusion, &view->clip);
+		}
+		above = view;
 
 		surface_damage = &view->surface->state.damage;
 
 		if (pixman_region32_not_empty(surface_damage)) {
 			renderer_flush_view(view);
 
-			/* Translate surface damage to global coordinates. */
-			pixman_region32_translate(surface_damage, geom->x, geom->y);
+			/* The contents of views on overlay planes are not composited. */
+			if (!view->plane) {
+				/* Translate surface damage to global coordinates. */
+				pixman_region32_translate(surface_damage, geom->x, geom->y);
 
-			/* Add the surface damage to the compositor damage. */
-			pixman_region32_union(&compositor.damage, &compositor.damage, surface_damage);
+				/* Add the surface damage to the compositor damage. */
+				pixman_region32_union(&compositor.damage, &compositor.damage, surface_damage);
+			}
 			pixman_region32_clear(surface_damage);
 		}
 
@@ -661,43 +1679,311 @@ calculate_damage(void)
 		}
 	}
 
-	pixman_region32_fini(&surface_opaque);
+	if (dirty) {
+		if (above)
+			pixman_region32_copy(&compositor.opaque, &above->occlusion);
+		else
+			pixman_region32_clear(&compositor.opaque);
+	}
+}
+
+/**
+ * Returns the buffer that an overlay plane would scan out for the view, if
+ * any. YUV buffers are composited from a conversion, but scanned out as they
+ * are.
+ */
+static struct wld_buffer *
+scanout_buffer(struct compositor_view *view)
+{
+	if (!view->buffer || view->solid)
+		return NULL;
+	if (dmabuf_get_planes(view->base.buffer))
+		return view->base.buffer;
+
+	return has_proxy(view) ? NULL : view->buffer;
+}
+
+/**
+ * Returns the topmost view on the target if it covers all of the target, so
+ * that its buffer could be scanned out by the primary plane.
+ */
+static struct compositor_view *
+find_fullscreen_view(struct target *target)
+{
+	struct compositor_view *view;
+	const struct swc_rectangle *geom = &target->view->geometry;
+
+	wl_list_for_each (view, &compositor.views, link) {
+		if (view->visible && view->base.screens & target->mask)
+			goto found;
+	}
+
+	return NULL;
+
+found:
+	if (view->base.geometry.x != geom->x || view->base.geometry.y != geom->y
+	    || view->base.geometry.width != geom->width || view->base.geometry.height != geom->height)
+		return NULL;
+
+	return view;
+}
+
+/**
+ * Returns the view whose buffer can be scanned out directly on the target's
+ * screen, or NULL if the screen needs to be composited.
+ *
+ * This is the case when the topmost visible view on the screen is opaque,
+ * covers the screen exactly, and its buffer can be used as a framebuffer.
+ */
+static struct compositor_view *
+find_scanout_view(struct target *target)
+{
+	struct compositor_view *view;
+	const struct swc_rectangle *geom = &target->view->geometry;
+	pixman_box32_t box;
+	wl_fixed_t x, y, width, height;
+
+	if (!(view = find_fullscreen_view(target)))
+		return NULL;
+	if (!view->buffer || view->solid || has_proxy(view))
+		return NULL;
+	/* YUV buffers are only scanned out by overlay planes. */
+	if (dmabuf_get_planes(view->buffer))
+		return NULL;
+	if (view->base.buffer->width != geom->width || view->base.buffer->height != geom->height)
+		return NULL;
+	/* The primary plane can't crop or scale. */
+	if (surface_get_source(view->surface, &x, &y, &width, &height))
+		return NULL;
+
+	if (view->base.buffer->format != WLD_FORMAT_XRGB8888) {
+		box = (pixman_box32_t){ 0, 0, geom->width, geom->height };
+		if (pixman_region32_contains_rectangle(&view->surface->state.opaque, &box) != PIXMAN_REGION_IN)
+			return NULL;
+	}
+
+	if (!drm_get_framebuffer(view->buffer))
+		return NULL;
+
+	return view;
+}
+
+/**
+ * Returns whether the view is placed so that it can be displayed on an overlay
+ * plane.
+ *
+ * The view must lie within a single screen. Since the plane is stacked above
+ * the composited content and the stacking order of overlay planes relative to
+ * each other is unknown, nothing above the view may overlap it.
+ */
+static bool
+view_fits_overlay(struct compositor_view *view, struct target *target, pixman_region32_t *above)
+{
+	const struct swc_rectangle *geom = &view->base.geometry, *target_geom = &target->view->geometry;
+	pixman_box32_t box;
+
+	if (geom->x < target_geom->x || geom->y < target_geom->y
+	    || geom->x + geom->width > target_geom->x + target_geom->width
+	    || geom->y + geom->height > target_geom->y + target_geom->height)
+		return false;
+
+	box = (pixman_box32_t){ geom->x, geom->y, geom->x + geom->width, geom->y + geom->height };
+	return pixman_region32_contains_rectangle(above, &box) == PIXMAN_REGION_OUT;
+}
+
+/**
+ * Returns whether the view's buffer is usable as a framebuffer in a format and
+ * with a modifier the plane supports.
+ */
+static bool
+buffer_fits_plane(struct compositor_view *view, struct plane *plane)
+{
+	struct wld_buffer *buffer = scanout_buffer(view);
+	const struct dmabuf_planes *planes;
+
+	if (!buffer)
+		return false;
+	if ((planes = dmabuf_get_planes(buffer)))
+		return plane_supports_modifier(plane, planes->format, planes->modifier) && drm_get_framebuffer(buffer);
+
+	return plane_supports_modifier(plane, buffer->format, dmabuf_get_modifier(buffer)) && drm_get_framebuffer(buffer);
+}
+
+static bool
+plane_show_view(struct plane *plane, struct compositor_view *view)
+{
+	const struct swc_rectangle *geom = &view->base.geometry, *plane_geom = &plane->view.geometry;
+	struct wld_buffer *buffer = scanout_buffer(view);
+	wl_fixed_t x = 0, y = 0, width, height;
+
+	/* Cropping and scaling of a viewport are done by the plane itself. */
+	width = wl_fixed_from_int(buffer->width);
+	height = wl_fixed_from_int(buffer->height);
+	surface_get_source(view->surface, &x, &y, &width, &height);
+
+	if (plane->view.buffer == buffer && plane_geom->x == geom->x && plane_geom->y == geom->y
+	    && plane_geom->width == geom->width && plane_geom->height == geom->height
+	    && plane->src.x == (uint32_t)x << 8 && plane->src.y == (uint32_t)y << 8
+	    && plane->src.width == (uint32_t)width << 8 && plane->src.height == (uint32_t)height << 8)
+		return true;
+	if (view_attach(&plane->view, buffer) < 0)
+		return false;
+	plane_set_viewport(plane, (uint32_t)x << 8, (uint32_t)y << 8, (uint32_t)width << 8, (uint32_t)height << 8, geom->width, geom->height);
+	view_move(&plane->view, geom->x, geom->y);
+	return view_update(&plane->view);
+}
+
+/**
+ * Assigns the topmost suitable views on the target's screen to its overlay
+ * planes, and disables the planes left over.
+ *
+ * Views moving on or off a plane have their area damaged so that the
+ * composited content beneath them is brought up to date. The planes are
+ * committed together with the next framebuffer of the primary plane, so both
+ * take effect with the same page flip.
+ */
+static void
+assign_planes(struct target *target, struct screen *screen, bool scanout)
+{
+	struct compositor_view *view, *fullscreen;
+	struct plane *plane, *candidate;
+	struct wl_list *next = &screen->planes.overlays;
+	pixman_region32_t above;
+
+	pixman_region32_init(&above);
+	fullscreen = find_fullscreen_view(target);
+
+	wl_list_for_each (view, &compositor.views, link) {
+		if (!view->visible || !(view->base.screens & target->mask))
+			continue;
+
+		plane = NULL;
+		candidate = NULL;
+		if (!scanout && next->next != &screen->planes.overlays && view_fits_overlay(view, target, &above)) {
+			candidate = wl_container_of(next->next, candidate, link);
+			if (buffer_fits_plane(view, candidate) && plane_show_view(candidate, view)) {
+				plane = candidate;
+				next = next->next;
+			}
+		}
+
+		/* Let the client allocate buffers that the plane can scan out,
+		 * whether or not its current buffer can be. A view covering the
+		 * screen is best scanned out by the primary plane. */
+		if (view == fullscreen && screen->planes.primary.plane)
+			candidate = screen->planes.primary.plane;
+		dmabuf_set_scanout_plane(view->surface, candidate);
+
+		if (view->plane != plane) {
+			damage_view(view);
+			view->plane = plane;
+			if (!plane && view->proxy_stale)
+				refresh_proxy(view);
+		}
+
+		pixman_region32_union_rect(&above, &above, view->extents.x1, view->extents.y1,
+		                           view->extents.x2 - view->extents.x1, view->extents.y2 - view->extents.y1);
+	}
+
+	pixman_region32_fini(&above);
+
+	for (next = next->next; next != &screen->planes.overlays; next = next->next) {
+		plane = wl_container_of(next, plane, link);
+		if (plane->view.buffer) {
+			view_attach(&plane->view, NULL);
+			view_update(&plane->view);
+		}
+	}
 }
 
 static void
-update_screen(struct screen *screen)
+update_screen(struct screen *screen, uint32_t updates)
 {
 	struct target *target;
+	struct compositor_view *view, *scanout;
 	const struct swc_rectangle *geom = &screen->base.geometry;
 	pixman_region32_t damage, *total_damage;
+	int ret;
 
 	if (!(compositor.scheduled_updates & screen_mask(screen)))
 		return;
 	if (!(target = target_get(screen)))
 		return;
 
+	scanout = find_scanout_view(target);
+	if (updates & screen_mask(screen))
+		assign_planes(target, screen, scanout);
+
 	pixman_region32_init(&damage);
-	pixman_region32_intersect_rect(&damage, &compositor.damage, geom->x, geom->y, geom->width, geom->height);
-	pixman_region32_translate(&damage, -geom->x, -geom->y);
+	if (target->scanout && !scanout) {
+		/* The target's buffers have not been kept up to date while a
+		 * client buffer was being scanned out. */
+		pixman_region32_union_rect(&damage, &damage, 0, 0, geom->width, geom->height);
+	} else {
+		pixman_region32_intersect_rect(&damage, &compositor.damage, geom->x, geom->y, geom->width, geom->height);
+		pixman_region32_translate(&damage, -geom->x, -geom->y);
+	}
 
-	total_damage = wld_surface_damage(target->surface, &damage);
+	total_damage = target_add_damage(target, &damage);
 
-	/* Don't repaint the screen if it is waiting for a page flip. */
-	if (compositor.pending_flips & screen_mask(screen)) {
+	/* Don't repaint the screen if it is waiting for a page flip or its repaint
+	 * is not due yet, but keep track of the damage. */
+	if (!(updates & screen_mask(screen))) {
 		pixman_region32_fini(&damage);
 		return;
 	}
 
-	pixman_region32_t base_damage;
+	if (scanout) {
+		ret = target_scanout(target, scanout);
+		if (ret == 0 || ret == -EACCES) {
+			pixman_region32_fini(&damage);
+			target->scanout = true;
+			goto done;
+		}
+
+		/* The client buffer could not be flipped, so fall back to
+		 * compositing a complete frame. */
+		if (target->scanout) {
+			pixman_region32_union_rect(&damage, &damage, 0, 0, geom->width, geom->height);
+			total_damage = target_add_damage(target, &damage);
+		}
+	}
+
+	target->scanout = false;
+
+	pixman_region32_t base_damage, copy;
+	pixman_region32_init(&copy);
 	pixman_region32_copy(&damage, total_damage);
+	primary_plane_set_damage(&screen->planes.primary, &damage);
+
+	/* Taking the buffer resets its damage, so do so only once it is copied. */
+	if (!(target->next_buffer = wld_surface_take(target->surface))) {
+		ERROR("Could not get buffer for screen\n");
+		pixman_region32_fini(&damage);
+		pixman_region32_fini(&copy);
+		return;
+	}
+
+	/* The shadow already holds everything but its own damage, but the buffer
+	 * needs all of its damage copied. */
+	if (target->shadow) {
+		pixman_region32_copy(&copy, &damage);
+		pixman_region32_copy(&damage, &target->shadow_damage);
+		pixman_region32_clear(&target->shadow_damage);
+	}
+
 	pixman_region32_translate(&damage, geom->x, geom->y);
 	pixman_region32_init(&base_damage);
 	pixman_region32_subtract(&base_damage, &damage, &compositor.opaque);
-	renderer_repaint(target, &damage, &base_damage, &compositor.views);
+	renderer_repaint(target, target->next_buffer, &damage, &base_damage, &copy, &compositor.views);
 	pixman_region32_fini(&damage);
 	pixman_region32_fini(&base_damage);
+	pixman_region32_fini(&copy);
+
+	ret = target_swap_buffers(target);
 
-	switch (target_swap_buffers(target)) {
+done:
+	switch (ret) {
 	case -EACCES:
 		/* If we get an EACCES, it is because this session is being deactivated, but
 		 * we haven't yet received the deactivate signal from swc-launch. */
@@ -705,15 +1991,32 @@ update_screen(struct screen *screen)
 		break;
 	case 0:
 		compositor.pending_flips |= screen_mask(screen);
+
+		/* The buffers of the views scanned out stay on screen until the
+		 * next frame is displayed, so they must neither be destroyed nor
+		 * released to their clients before then. */
+		if (target->scanout)
+			target_lock_buffer(target, scanout->base.buffer);
+		wl_list_for_each (view, &compositor.views, link) {
+			if (view->plane && view->visible && view->base.screens & target->mask)
+				target_lock_buffer(target, view->base.buffer);
+		}
+
+		/* The current content of every view on the screen is part of
+		 * this frame. */
+		wl_list_for_each (view, &compositor.views, link) {
+			if (view->visible && view->base.screens & target->mask)
+				surface_latch_feedback(view->surface);
+		}
 		break;
 	}
 }
 
 static void
-perform_update(void *data)
+perform_update(uint32_t screens)
 {
 	struct screen *screen;
-	uint32_t updates = compositor.scheduled_updates & ~compositor.pending_flips;
+	uint32_t updates = compositor.scheduled_updates & ~compositor.pending_flips & screens;
 
 	if (!swc.active || !updates)
 		return;
@@ -724,7 +2027,7 @@ perform_update(void *data)
 	calculate_damage();
 
 	wl_list_for_each (screen, &swc.screens, link)
-		update_screen(screen);
+		update_screen(screen, updates);
 
 	/* XXX: Should assert that all damage was covered by some output */
 	pixman_region32_clear(&compositor.damage);
@@ -732,6 +2035,18 @@ perform_update(void *data)
 	compositor.updating = false;
 }
 
+EXPORT void
+swc_set_repaint_margin(uint32_t margin)
+{
+	compositor.repaint_margin = margin;
+}
+
+EXPORT void
+swc_set_frame_budget(uint32_t budget)
+{
+	compositor.frame_budget = budget;
+}
+
 void
 compositor_render_screen(struct screen *screen, struct wld_buffer *buffer)
 {
@@ -754,7 +2069,7 @@ compositor_render_screen(struct screen *screen, struct wld_buffer *buffer)
 
 	wl_list_for_each_reverse (view, &compositor.views, link) {
 		if (view->visible && view->base.screens & screenshot_target.mask) {
-			repaint_view(swc.shm->renderer, &screenshot_target, view, &damage);
+			repaint_view(swc.shm->renderer, &screenshot_target, view, &damage, false);
 		}
 	}
 
@@ -766,17 +2081,19 @@ bool
 handle_motion(struct pointer_handler *handler, uint32_t time, wl_fixed_t fx, wl_fixed_t fy)
 {
 	struct compositor_view *view;
+	struct grid_item **items;
 	bool found = false;
 	int32_t x = wl_fixed_to_int(fx), y = wl_fixed_to_int(fy);
 	struct swc_rectangle *geom;
+	size_t i, count;
 
 	/* If buttons are pressed, don't change pointer focus. */
 	if (swc.seat->pointer->buttons.size > 0)
 		return false;
 
-	wl_list_for_each (view, &compositor.views, link) {
-		if (!view->visible)
-			continue;
+	items = grid_lookup(&compositor.grid, x, y, &count);
+	for (i = 0; i < count; ++i) {
+		view = wl_container_of(items[i], view, grid_item);
 		geom = &view->base.geometry;
 		if (rectangle_contains_point(geom, x, y)) {
 			if (pixman_region32_contains_point(&view->surface->state.input, x - geom->x, y - geom->y, NULL)) {
@@ -863,10 +2180,28 @@ bind_compositor(struct wl_client *client, void *data, uint32_t version, uint32_t
 	wl_resource_set_implementation(resource, &compositor_impl, NULL, NULL);
 }
 
+static unsigned
+count_render_threads(void)
+{
+	const char *env;
+	long count;
+
+	if ((env = getenv("SWC_RENDER_THREADS")))
+		count = strtol(env, NULL, 10);
+	else
+		count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return MIN(MAX(count, 1), 16);
+}
+
 bool
 compositor_initialize(void)
 {
 	struct screen *screen;
+	struct swc_rectangle bounds = { 0 };
+	pixman_box32_t extents;
+	pixman_region32_t region;
+	const char *env;
 	uint32_t keysym;
 
 	compositor.global = wl_global_create(swc.display, &wl_compositor_interface, 4, NULL, &bind_compositor);
@@ -874,6 +2209,53 @@ compositor_initialize(void)
 	if (!compositor.global)
 		return false;
 
+	/* The pointer is confined to the screens, so views need only be found
+	 * within their extents. */
+	pixman_region32_init(&region);
+	wl_list_for_each (screen, &swc.screens, link) {
+		struct swc_rectangle *geom = &screen->base.geometry;
+		pixman_region32_union_rect(&region, &region, geom->x, geom->y, geom->width, geom->height);
+	}
+	extents = *pixman_region32_extents(&region);
+	pixman_region32_fini(&region);
+	bounds.x = extents.x1;
+	bounds.y = extents.y1;
+	bounds.width = extents.x2 - extents.x1;
+	bounds.height = extents.y2 - extents.y1;
+
+	if (!grid_initialize(&compositor.grid, &bounds, 128)) {
+		wl_global_destroy(compositor.global);
+		return false;
+	}
+
+	if (!buffer_pool_initialize()) {
+		grid_finalize(&compositor.grid);
+		wl_global_destroy(compositor.global);
+		return false;
+	}
+
+	if (!(compositor.reclaim_timer = wl_event_loop_add_timer(swc.event_loop, &handle_reclaim_timer, NULL))) {
+		buffer_pool_finalize();
+		grid_finalize(&compositor.grid);
+		wl_global_destroy(compositor.global);
+		return false;
+	}
+
+	/* Composition with pixman runs on the CPU, so spread it over the cores. */
+	compositor.render_pool = NULL;
+	compositor.render_threads = 1;
+	compositor.pixman = swc.headless || wld_drm_is_dumb(swc.drm->context);
+	if (compositor.pixman) {
+		compositor.render_threads = count_render_threads();
+		if (compositor.render_threads > 1 && !(compositor.render_pool = thread_pool_create(compositor.render_threads - 1)))
+			WARNING("Could not create render threads\n");
+	}
+
+	/* Dumb buffers are usually uncached or write-combined, so reading them
+	 * back while compositing is slow. */
+	env = getenv("SWC_SHADOW");
+	compositor.shadow = !swc.headless && compositor.pixman && !(env && strcmp(env, "0") == 0);
+
 	compositor.scheduled_updates = 0;
 	compositor.pending_flips = 0;
 	compositor.updating = false;
@@ -902,5 +2284,11 @@ compositor_finalize(void)
 {
 	pixman_region32_fini(&compositor.damage);
 	pixman_region32_fini(&compositor.opaque);
+	grid_finalize(&compositor.grid);
+	wl_event_source_remove(compositor.reclaim_timer);
+	compositor.reclaim_timer = NULL;
+	buffer_pool_finalize();
+	if (compositor.render_pool)
+		thread_pool_destroy(compositor.render_pool);
 	wl_global_destroy(compositor.global);
 }
@@ -25,11 +25,13 @@
 #ifndef SWC_COMPOSITOR_H
 #define SWC_COMPOSITOR_H
 
+#include "grid.h"
 #include "view.h"
 
 #include <pixman.h>
 #include <stdbool.h>
 #include <wayland-server.h>
+struct plane;
 struct screen;
 struct surface;
 struct window;
@@ -64,6 +66,19 @@ struct compositor_view {
 	/* Whether or not the view is a background. */
 	bool background;
 
+	/* Whether the view's buffer is a single pixel, which is filled over the
+	 * whole view with solid_color rather than copied. */
+	bool solid;
+	uint32_t solid_color;
+
+	/* When rendering with wld, which cannot scale, a copy of the content of
+	 * a view whose buffer is cropped or scaled at the view's size. */
+	struct wld_buffer *scaled;
+	bool scaled_dirty;
+
+	/* The overlay plane displaying the view, or NULL if it is composited. */
+	struct plane *plane;
+
 	/* The box that the surface covers (including it's border). */
 	pixman_box32_t extents;
 
@@ -71,6 +86,26 @@ struct compositor_view {
 	 * surface. */
 	pixman_region32_t clip;
 
+	/* The clip region together with the surface's own opaque region, which is
+	 * the clip region of the next visible view below. */
+	pixman_region32_t occlusion;
+
+	/* Whether the clip regions of this view and those below it need to be
+	 * recalculated. */
+	bool clip_dirty;
+
+	/* The view's entry in the grid used to find the view under the pointer. */
+	struct grid_item grid_item;
+
+	/* When the view was last hidden, and whether its proxy was dropped since
+	 * to be rebuilt once it is shown again. */
+	uint32_t hide_time;
+	bool proxy_reclaimed;
+
+	/* Whether the proxy was not kept up to date while the client buffer was
+	 * scanned out by an overlay plane. */
+	bool proxy_stale;
+
 	struct {
 		uint32_t width;
 		uint32_t color;
@@ -90,8 +125,20 @@ void compositor_view_destroy(struct compositor_view *view);
  */
 struct compositor_view *compositor_view(struct view *view);
 
+/**
+ * Notifies the compositor that the opaque region of the view's surface has
+ * changed.
+ */
+void compositor_view_update_opaque(struct compositor_view *view);
+
 void compositor_view_set_parent(struct compositor_view *view, struct compositor_view *parent);
 
+/**
+ * Moves the view directly above or below another view in the stacking order.
+ */
+void compositor_view_place_above(struct compositor_view *view, struct compositor_view *sibling);
+void compositor_view_place_below(struct compositor_view *view, struct compositor_view *sibling);
+
 void compositor_view_show(struct compositor_view *view);
 void compositor_view_hide(struct compositor_view *view);
 
@@ -24,17 +24,98 @@
 #include "dmabuf.h"
 #include "drm.h"
 #include "internal.h"
+#include "plane.h"
+#include "shm.h"
+#include "surface.h"
 #include "util.h"
 #include "wayland_buffer.h"
+#include "yuv.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <drm_fourcc.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wld/wld.h>
 #include <wld/drm.h>
+#include <xf86drm.h>
+#ifdef __linux__
+#include <linux/dma-buf.h>
+#endif
 #include "linux-dmabuf-unstable-v1-server-protocol.h"
 
+enum {
+	WLD_USER_OBJECT_DMABUF_MAPPING = WLD_USER_ID + 1,
+	WLD_USER_OBJECT_DMABUF_MODIFIER = WLD_USER_ID + 4,
+	WLD_USER_OBJECT_DMABUF_YUV = WLD_USER_ID + 5,
+};
+
+/* The explicit modifier of an imported dmabuf, needed to create a
+ * framebuffer for it. */
+struct modifier {
+	struct wld_exporter exporter;
+	struct wld_destructor destructor;
+	uint64_t modifier;
+};
+
+/* A dmabuf mapped for the CPU, backing a pixman buffer. */
+struct mapping {
+	struct wld_exporter exporter;
+	struct wld_destructor destructor;
+	int fd;
+	void *data;
+	size_t size;
+};
+
+/* A multi-planar YUV dmabuf mapped for the CPU, backing a pixman buffer of
+ * its contents converted to XRGB8888. Only the parts that are read after
+ * being damaged are converted. */
+struct yuv_buffer {
+	struct wld_exporter exporter;
+	struct wld_destructor destructor;
+	struct dmabuf_planes planes;
+	void *data[4];
+	size_t size[4];
+	uint32_t *pixels;
+	uint32_t width, height;
+	pixman_region32_t stale;
+};
+
+/* The format-modifier pairs that can be imported, as shared with clients in
+ * the format table of dmabuf feedback. */
+struct format_table_entry {
+	uint32_t format, pad;
+	uint64_t modifier;
+};
+
+static const uint32_t formats[] = {
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ARGB8888,
+};
+
+/* YUV buffers are always read by the CPU, so they must be linear. */
+static const uint32_t yuv_formats[] = {
+	DRM_FORMAT_NV12,
+	DRM_FORMAT_P010,
+	DRM_FORMAT_YUV420,
+};
+
+/* Convert damaged YUV buffers in tiles of this size, which keeps the
+ * converted region simple. */
+#define YUV_TILE_SIZE 16
+
+static struct {
+	struct format_table_entry *entries;
+	uint32_t num_entries;
+	int fd;
+	dev_t main_device;
+	bool initialized;
+} feedback;
+
 struct params {
 	struct wl_resource *resource;
 	int fd[4];
@@ -53,7 +134,7 @@ add(struct wl_client *client, struct wl_resource *resource, int32_t fd, uint32_t
 		wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED, "buffer already created");
 		return;
 	}
-	if (i > ARRAY_LENGTH(params->fd)) {
+	if (i >= ARRAY_LENGTH(params->fd)) {
 		wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX, "plane index too large");
 		return;
 	}
@@ -67,6 +148,338 @@ add(struct wl_client *client, struct wl_resource *resource, int32_t fd, uint32_t
 	params->modifier[i] = (uint64_t)modifier_hi << 32 | modifier_lo;
 }
 
+static bool
+mapping_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
+{
+	struct mapping *mapping = wl_container_of(exporter, mapping, exporter);
+
+	switch (type) {
+	case WLD_USER_OBJECT_DMABUF_MAPPING:
+		object->ptr = mapping;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void
+mapping_destroy(struct wld_destructor *destructor)
+{
+	struct mapping *mapping = wl_container_of(destructor, mapping, destructor);
+
+	munmap(mapping->data, mapping->size);
+	close(mapping->fd);
+	free(mapping);
+}
+
+/**
+ * Imports a linear dmabuf as a pixman buffer reading its mapping in place,
+ * taking ownership of the file descriptor on success.
+ */
+static struct wld_buffer *
+import_mapping(int fd, uint32_t offset, uint64_t modifier, int32_t width, int32_t height, uint32_t format, uint32_t stride)
+{
+	struct mapping *mapping;
+	struct wld_buffer *buffer;
+	union wld_object object;
+	off_t size;
+
+	/* Without a GPU, buffers with an implicit modifier are linear. */
+	if (modifier != DRM_FORMAT_MOD_LINEAR && modifier != DRM_FORMAT_MOD_INVALID)
+		goto error0;
+	if (!(mapping = malloc(sizeof(*mapping))))
+		goto error0;
+	mapping->size = (size_t)offset + (size_t)stride * height;
+	if ((size = lseek(fd, 0, SEEK_END)) != -1 && size < mapping->size) {
+		DEBUG("dmabuf is too small for its dimensions\n");
+		goto error1;
+	}
+	mapping->data = mmap(NULL, mapping->size, PROT_READ, MAP_SHARED, fd, 0);
+	if (mapping->data == MAP_FAILED) {
+		DEBUG("Could not map dmabuf: %s\n", strerror(errno));
+		goto error1;
+	}
+	object.ptr = (char *)mapping->data + offset;
+	if (!(buffer = wld_import_buffer(swc.shm->context, WLD_OBJECT_DATA, object, width, height, format, stride)))
+		goto error2;
+	mapping->fd = fd;
+	mapping->exporter.export = &mapping_export;
+	wld_buffer_add_exporter(buffer, &mapping->exporter);
+	mapping->destructor.destroy = &mapping_destroy;
+	wld_buffer_add_destructor(buffer, &mapping->destructor);
+
+	return buffer;
+
+error2:
+	munmap(mapping->data, mapping->size);
+error1:
+	free(mapping);
+error0:
+	return NULL;
+}
+
+static bool
+modifier_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
+{
+	struct modifier *modifier = wl_container_of(exporter, modifier, exporter);
+
+	switch (type) {
+	case WLD_USER_OBJECT_DMABUF_MODIFIER:
+		object->ptr = modifier;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void
+modifier_destroy(struct wld_destructor *destructor)
+{
+	struct modifier *modifier = wl_container_of(destructor, modifier, destructor);
+
+	free(modifier);
+}
+
+static bool
+set_modifier(struct wld_buffer *buffer, uint64_t value)
+{
+	struct modifier *modifier;
+
+	if (!(modifier = malloc(sizeof(*modifier))))
+		return false;
+	modifier->modifier = value;
+	modifier->exporter.export = &modifier_export;
+	wld_buffer_add_exporter(buffer, &modifier->exporter);
+	modifier->destructor.destroy = &modifier_destroy;
+	wld_buffer_add_destructor(buffer, &modifier->destructor);
+
+	return true;
+}
+
+uint64_t
+dmabuf_get_modifier(struct wld_buffer *buffer)
+{
+	union wld_object object;
+
+	if (!wld_export(buffer, WLD_USER_OBJECT_DMABUF_MODIFIER, &object))
+		return DRM_FORMAT_MOD_INVALID;
+
+	return ((struct modifier *)object.ptr)->modifier;
+}
+
+static void
+sync_fd(int fd, bool start)
+{
+#ifdef DMA_BUF_IOCTL_SYNC
+	struct dma_buf_sync sync = { .flags = DMA_BUF_SYNC_READ };
+	int ret;
+
+	sync.flags |= start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END;
+	do ret = ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+	while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+	if (ret == -1)
+		DEBUG("Could not synchronize dmabuf access: %s\n", strerror(errno));
+#endif
+}
+
+static void
+sync_mapping(struct wld_buffer *buffer, bool start)
+{
+	union wld_object object;
+
+	if (wld_export(buffer, WLD_USER_OBJECT_DMABUF_MAPPING, &object))
+		sync_fd(((struct mapping *)object.ptr)->fd, start);
+}
+
+static bool
+yuv_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
+{
+	struct yuv_buffer *yuv = wl_container_of(exporter, yuv, exporter);
+
+	switch (type) {
+	case WLD_USER_OBJECT_DMABUF_YUV:
+		object->ptr = yuv;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void
+yuv_destroy(struct wld_destructor *destructor)
+{
+	struct yuv_buffer *yuv = wl_container_of(destructor, yuv, destructor);
+	uint32_t i;
+
+	for (i = 0; i < yuv->planes.num_planes; ++i) {
+		munmap(yuv->data[i], yuv->size[i]);
+		close(yuv->planes.fd[i]);
+	}
+	pixman_region32_fini(&yuv->stale);
+	free(yuv->pixels);
+	free(yuv);
+}
+
+static struct yuv_buffer *
+get_yuv(struct wld_buffer *buffer)
+{
+	union wld_object object;
+
+	return buffer && wld_export(buffer, WLD_USER_OBJECT_DMABUF_YUV, &object) ? object.ptr : NULL;
+}
+
+/**
+ * Imports a linear multi-planar YUV dmabuf as a pixman buffer, taking
+ * ownership of the file descriptors of its planes on success.
+ */
+static struct wld_buffer *
+import_yuv(struct params *params, int32_t width, int32_t height, uint32_t format)
+{
+	struct yuv_buffer *yuv;
+	struct wld_buffer *buffer;
+	union wld_object object;
+	uint32_t i, row_size, rows;
+	off_t size;
+
+	/* Without a GPU, buffers with an implicit modifier are linear. */
+	if (params->modifier[0] != DRM_FORMAT_MOD_LINEAR
+	    && !(params->modifier[0] == DRM_FORMAT_MOD_INVALID && wld_drm_is_dumb(swc.drm->context)))
+		goto error0;
+	if (width <= 0 || height <= 0 || !(yuv = malloc(sizeof(*yuv))))
+		goto error0;
+	yuv->planes.format = format;
+	yuv->planes.modifier = params->modifier[0];
+	yuv->planes.num_planes = yuv_num_planes(format);
+	for (i = 0; i < yuv->planes.num_planes; ++i) {
+		yuv_plane_size(format, i, width, height, &row_size, &rows);
+		if (params->modifier[i] != params->modifier[0] || params->stride[i] < row_size) {
+			DEBUG("Invalid layout of dmabuf plane %u\n", i);
+			goto error1;
+		}
+		yuv->size[i] = (size_t)params->offset[i] + (size_t)params->stride[i] * rows;
+		if ((size = lseek(params->fd[i], 0, SEEK_END)) != -1 && size < yuv->size[i]) {
+			DEBUG("dmabuf is too small for its dimensions\n");
+			goto error1;
+		}
+		yuv->data[i] = mmap(NULL, yuv->size[i], PROT_READ, MAP_SHARED, params->fd[i], 0);
+		if (yuv->data[i] == MAP_FAILED) {
+			DEBUG("Could not map dmabuf: %s\n", strerror(errno));
+			goto error1;
+		}
+	}
+	if (!(yuv->pixels = malloc((size_t)width * height * 4)))
+		goto error1;
+	object.ptr = yuv->pixels;
+	if (!(buffer = wld_import_buffer(swc.shm->context, WLD_OBJECT_DATA, object, width, height, WLD_FORMAT_XRGB8888, width * 4)))
+		goto error2;
+	for (i = 0; i < yuv->planes.num_planes; ++i) {
+		yuv->planes.fd[i] = params->fd[i];
+		yuv->planes.offset[i] = params->offset[i];
+		yuv->planes.stride[i] = params->stride[i];
+		params->fd[i] = -1;
+	}
+	yuv->width = width;
+	yuv->height = height;
+	pixman_region32_init_rect(&yuv->stale, 0, 0, width, height);
+	yuv->exporter.export = &yuv_export;
+	wld_buffer_add_exporter(buffer, &yuv->exporter);
+	yuv->destructor.destroy = &yuv_destroy;
+	wld_buffer_add_destructor(buffer, &yuv->destructor);
+
+	return buffer;
+
+error2:
+	free(yuv->pixels);
+error1:
+	while (i-- > 0)
+		munmap(yuv->data[i], yuv->size[i]);
+	free(yuv);
+error0:
+	return NULL;
+}
+
+/**
+ * Converts the stale tiles of a YUV buffer.
+ */
+static void
+update_yuv(struct yuv_buffer *yuv)
+{
+	const uint8_t *planes[4];
+	pixman_region32_t tiles;
+	pixman_box32_t *boxes;
+	int32_t x1, y1, x2, y2;
+	int i, num_boxes;
+
+	if (!pixman_region32_not_empty(&yuv->stale))
+		return;
+
+	pixman_region32_init(&tiles);
+	boxes = pixman_region32_rectangles(&yuv->stale, &num_boxes);
+	for (i = 0; i < num_boxes; ++i) {
+		x1 = boxes[i].x1 & ~(YUV_TILE_SIZE - 1);
+		y1 = boxes[i].y1 & ~(YUV_TILE_SIZE - 1);
+		x2 = MIN((boxes[i].x2 + YUV_TILE_SIZE - 1) & ~(YUV_TILE_SIZE - 1), yuv->width);
+		y2 = MIN((boxes[i].y2 + YUV_TILE_SIZE - 1) & ~(YUV_TILE_SIZE - 1), yuv->height);
+		pixman_region32_union_rect(&tiles, &tiles, x1, y1, x2 - x1, y2 - y1);
+	}
+
+	for (i = 0; i < yuv->planes.num_planes; ++i) {
+		planes[i] = (const uint8_t *)yuv->data[i] + yuv->planes.offset[i];
+		sync_fd(yuv->planes.fd[i], true);
+	}
+	boxes = pixman_region32_rectangles(&tiles, &num_boxes);
+	for (i = 0; i < num_boxes; ++i)
+		yuv_convert(yuv->planes.format, planes, yuv->planes.stride, yuv->pixels, yuv->width * 4, &boxes[i]);
+	for (i = 0; i < yuv->planes.num_planes; ++i)
+		sync_fd(yuv->planes.fd[i], false);
+
+	pixman_region32_clear(&yuv->stale);
+	pixman_region32_fini(&tiles);
+}
+
+void
+dmabuf_begin_read(struct wld_buffer *buffer)
+{
+	struct yuv_buffer *yuv;
+
+	/* The converted pixels are ordinary memory. */
+	if ((yuv = get_yuv(buffer)))
+		update_yuv(yuv);
+	else
+		sync_mapping(buffer, true);
+}
+
+void
+dmabuf_end_read(struct wld_buffer *buffer)
+{
+	sync_mapping(buffer, false);
+}
+
+void
+dmabuf_damage(struct wld_buffer *buffer, pixman_region32_t *damage)
+{
+	struct yuv_buffer *yuv;
+
+	if (!(yuv = get_yuv(buffer)))
+		return;
+	pixman_region32_union(&yuv->stale, &yuv->stale, damage);
+	pixman_region32_intersect_rect(&yuv->stale, &yuv->stale, 0, 0, yuv->width, yuv->height);
+}
+
+const struct dmabuf_planes *
+dmabuf_get_planes(struct wld_buffer *buffer)
+{
+	struct yuv_buffer *yuv;
+
+	return (yuv = get_yuv(buffer)) ? &yuv->planes : NULL;
+}
+
 static void
 create_immed(struct wl_client *client, struct wl_resource *resource, uint32_t id,
              int32_t width, int32_t height, uint32_t format, uint32_t flags)
@@ -87,20 +500,45 @@ create_immed(struct wl_client *client, struct wl_resource *resource, uint32_t id
 	case DRM_FORMAT_ARGB8888:
 		num_planes = 1;
 		break;
+	case DRM_FORMAT_NV12:
+	case DRM_FORMAT_P010:
+	case DRM_FORMAT_YUV420:
+		num_planes = yuv_num_planes(format);
+		break;
 	default:
 		wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT, "unsupported format %#" PRIx32, format);
 		return;
 	}
 	for (i = 0; i < num_planes; ++i) {
-		if (params->fd[i] == -1)
+		if (params->fd[i] == -1) {
 			wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE, "missing plane %d", i);
+			return;
+		}
 	}
 	for (; i < ARRAY_LENGTH(params->fd); ++i) {
-		if (params->fd[i] != -1)
+		if (params->fd[i] != -1) {
 			wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE, "too many planes");
+			return;
+		}
+	}
+	if (num_planes > 1) {
+		/* Neither renderer can read YUV, so the planes are converted
+		 * by the CPU. */
+		buffer = import_yuv(params, width, height, format);
+	} else if (wld_drm_is_dumb(swc.drm->context)) {
+		/* Dumb buffers can't be imported, but the compositor renders with
+		 * pixman and can read the dmabuf directly. */
+		buffer = import_mapping(params->fd[0], params->offset[0], params->modifier[0], width, height, format, params->stride[0]);
+		if (buffer)
+			params->fd[0] = -1;
+	} else {
+		object.i = params->fd[0];
+		buffer = wld_import_buffer(swc.drm->context, WLD_DRM_OBJECT_PRIME_FD, object, width, height, format, params->stride[0]);
+		if (buffer && params->modifier[0] != DRM_FORMAT_MOD_INVALID && !set_modifier(buffer, params->modifier[0])) {
+			wld_buffer_unreference(buffer);
+			buffer = NULL;
+		}
 	}
-	object.i = params->fd[0];
-	buffer = wld_import_buffer(swc.drm->context, WLD_DRM_OBJECT_PRIME_FD, object, width, height, format, params->stride[0]);
 	for (i = 0; i < num_planes; ++i) {
 		close(params->fd[i]);
 		params->fd[i] = -1;
@@ -167,18 +605,218 @@ error0:
 	wl_resource_post_no_memory(resource);
 }
 
+static void
+add_entry(uint32_t format, uint64_t modifier)
+{
+	feedback.entries[feedback.num_entries].format = format;
+	feedback.entries[feedback.num_entries].modifier = modifier;
+	++feedback.num_entries;
+}
+
+/**
+ * Writes the format table to a sealed file that is shared with all clients,
+ * and looks up the device buffers are imported on.
+ */
+static bool
+initialize_feedback(void)
+{
+	struct stat st;
+	char *render_node;
+	size_t size;
+	uint32_t i;
+
+	if (feedback.initialized)
+		return true;
+
+	/* Clients allocate buffers on the main device, which should be the render
+	 * node, since they may not open the primary node. */
+	if ((render_node = drmGetRenderDeviceNameFromFd(swc.drm->fd))) {
+		if (stat(render_node, &st) == -1) {
+			ERROR("Could not stat render node %s: %s\n", render_node, strerror(errno));
+			free(render_node);
+			goto error0;
+		}
+		free(render_node);
+	} else if (fstat(swc.drm->fd, &st) == -1) {
+		ERROR("Could not stat DRM device: %s\n", strerror(errno));
+		goto error0;
+	}
+	feedback.main_device = st.st_rdev;
+
+	/* wld has no way to query the modifiers it can import, so besides
+	 * implicit modifiers only linear buffers, which every import path can
+	 * read, are advertised. */
+	if (!(feedback.entries = calloc((ARRAY_LENGTH(formats) + ARRAY_LENGTH(yuv_formats)) * 2, sizeof(feedback.entries[0]))))
+		goto error0;
+	feedback.num_entries = 0;
+	for (i = 0; i < ARRAY_LENGTH(formats); ++i) {
+		add_entry(formats[i], DRM_FORMAT_MOD_INVALID);
+		add_entry(formats[i], DRM_FORMAT_MOD_LINEAR);
+	}
+	for (i = 0; i < ARRAY_LENGTH(yuv_formats); ++i) {
+		if (wld_drm_is_dumb(swc.drm->context))
+			add_entry(yuv_formats[i], DRM_FORMAT_MOD_INVALID);
+		add_entry(yuv_formats[i], DRM_FORMAT_MOD_LINEAR);
+	}
+
+	size = feedback.num_entries * sizeof(feedback.entries[0]);
+	feedback.fd = memfd_create("swc-dmabuf-formats", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (feedback.fd == -1) {
+		ERROR("Could not create dmabuf format table: %s\n", strerror(errno));
+		goto error1;
+	}
+	if (write(feedback.fd, feedback.entries, size) != (ssize_t)size) {
+		ERROR("Could not write dmabuf format table\n");
+		goto error2;
+	}
+#ifdef F_ADD_SEALS
+	/* Clients map the table themselves, so it must not change under them. */
+	fcntl(feedback.fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+	feedback.initialized = true;
+
+	return true;
+
+error2:
+	close(feedback.fd);
+error1:
+	free(feedback.entries);
+error0:
+	return false;
+}
+
+static void
+send_tranche(struct wl_resource *resource, struct wl_array *device, struct plane *plane)
+{
+	struct wl_array indices;
+	uint16_t *index;
+	uint32_t i;
+
+	wl_array_init(&indices);
+	for (i = 0; i < feedback.num_entries; ++i) {
+		if (plane && !plane_supports_modifier(plane, feedback.entries[i].format, feedback.entries[i].modifier))
+			continue;
+		if (!(index = wl_array_add(&indices, sizeof(*index))))
+			goto done;
+		*index = i;
+	}
+	if (indices.size == 0)
+		goto done;
+
+	zwp_linux_dmabuf_feedback_v1_send_tranche_target_device(resource, device);
+	zwp_linux_dmabuf_feedback_v1_send_tranche_formats(resource, &indices);
+	zwp_linux_dmabuf_feedback_v1_send_tranche_flags(resource, plane ? ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SCANOUT : 0);
+	zwp_linux_dmabuf_feedback_v1_send_tranche_done(resource);
+
+done:
+	wl_array_release(&indices);
+}
+
+/**
+ * Sends the feedback's tranches, preceded by a tranche of the formats that the
+ * given plane can scan out if it is not NULL. The format table and main device
+ * are only sent for new feedback objects since they never change.
+ */
+static void
+send_feedback(struct wl_resource *resource, struct plane *plane, bool initial)
+{
+	struct wl_array device = { .size = sizeof(feedback.main_device), .data = &feedback.main_device };
+
+	if (initial) {
+		zwp_linux_dmabuf_feedback_v1_send_format_table(resource, feedback.fd, feedback.num_entries * sizeof(feedback.entries[0]));
+		zwp_linux_dmabuf_feedback_v1_send_main_device(resource, &device);
+	}
+	if (plane)
+		send_tranche(resource, &device, plane);
+	send_tranche(resource, &device, NULL);
+	zwp_linux_dmabuf_feedback_v1_send_done(resource);
+}
+
+static void
+feedback_destroy(struct wl_resource *resource)
+{
+	wl_list_remove(wl_resource_get_link(resource));
+}
+
+static const struct zwp_linux_dmabuf_feedback_v1_interface feedback_impl = {
+	.destroy = destroy_resource,
+};
+
+static struct wl_resource *
+create_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id)
+{
+	struct wl_resource *feedback_resource;
+
+	if (!initialize_feedback())
+		goto error0;
+	feedback_resource = wl_resource_create(client, &zwp_linux_dmabuf_feedback_v1_interface, wl_resource_get_version(resource), id);
+	if (!feedback_resource)
+		goto error0;
+	wl_resource_set_implementation(feedback_resource, &feedback_impl, NULL, &feedback_destroy);
+	wl_list_init(wl_resource_get_link(feedback_resource));
+
+	return feedback_resource;
+
+error0:
+	wl_resource_post_no_memory(resource);
+	return NULL;
+}
+
+static void
+get_default_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id)
+{
+	struct wl_resource *feedback_resource;
+
+	if (!(feedback_resource = create_feedback(client, resource, id)))
+		return;
+	send_feedback(feedback_resource, NULL, true);
+}
+
+static void
+get_surface_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id, struct wl_resource *surface_resource)
+{
+	struct surface *surface = wl_resource_get_user_data(surface_resource);
+	struct wl_resource *feedback_resource;
+
+	if (!(feedback_resource = create_feedback(client, resource, id)))
+		return;
+	wl_list_insert(&surface->dmabuf_feedbacks, wl_resource_get_link(feedback_resource));
+	send_feedback(feedback_resource, surface->scanout_plane, true);
+}
+
+void
+dmabuf_set_scanout_plane(struct surface *surface, struct plane *plane)
+{
+	struct wl_resource *resource;
+
+	if (surface->scanout_plane == plane)
+		return;
+	surface->scanout_plane = plane;
+	wl_resource_for_each (resource, &surface->dmabuf_feedbacks)
+		send_feedback(resource, plane, false);
+}
+
+void
+dmabuf_detach_feedbacks(struct wl_list *feedbacks)
+{
+	struct wl_resource *resource, *tmp;
+
+	wl_resource_for_each_safe (resource, tmp, feedbacks) {
+		wl_list_remove(wl_resource_get_link(resource));
+		wl_list_init(wl_resource_get_link(resource));
+	}
+}
+
 static const struct zwp_linux_dmabuf_v1_interface dmabuf_impl = {
 	.destroy = destroy_resource,
 	.create_params = create_params,
+	.get_default_feedback = get_default_feedback,
+	.get_surface_feedback = get_surface_feedback,
 };
 
 static void
 bind_dmabuf(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 {
-	static const uint32_t formats[] = {
-		DRM_FORMAT_XRGB8888,
-		DRM_FORMAT_ARGB8888,
-	};
 	uint64_t modifier = DRM_FORMAT_MOD_INVALID;
 	struct wl_resource *resource;
 	size_t i;
@@ -189,18 +827,26 @@ bind_dmabuf(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 		return;
 	}
 	wl_resource_set_implementation(resource, &dmabuf_impl, NULL, NULL);
+	/* Since version 4, formats are only advertised through feedback. */
+	if (version >= 4)
+		return;
 	for (i = 0; i < ARRAY_LENGTH(formats); ++i) {
 		if (version >= 3) {
-			/* TODO: need a way to query DRM modifiers of wld */
 			zwp_linux_dmabuf_v1_send_modifier(resource, formats[i], modifier >> 32, modifier & 0xffffffff);
 		} else {
 			zwp_linux_dmabuf_v1_send_format(resource, formats[i]);
 		}
 	}
+	/* The format event implies an implicit modifier. */
+	if (version < 3)
+		return;
+	modifier = DRM_FORMAT_MOD_LINEAR;
+	for (i = 0; i < ARRAY_LENGTH(yuv_formats); ++i)
+		zwp_linux_dmabuf_v1_send_modifier(resource, yuv_formats[i], modifier >> 32, modifier & 0xffffffff);
 }
 
 struct wl_global *
 swc_dmabuf_create(struct wl_display *display)
 {
-	return wl_global_create(display, &zwp_linux_dmabuf_v1_interface, 3, NULL, &bind_dmabuf);
+	return wl_global_create(display, &zwp_linux_dmabuf_v1_interface, 4, NULL, &bind_dmabuf);
 }
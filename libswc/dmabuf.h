@@ -24,8 +24,61 @@
 #ifndef SWC_DMABUF_H
 #define SWC_DMABUF_H
 
+#include <stdint.h>
+#include <pixman.h>
+
+struct plane;
+struct surface;
 struct wl_display;
+struct wl_list;
+struct wld_buffer;
+
+/* The planes of a multi-planar dmabuf, as its client created it. */
+struct dmabuf_planes {
+	uint32_t format;
+	uint64_t modifier;
+	uint32_t num_planes;
+	int fd[4];
+	uint32_t offset[4], stride[4];
+};
 
 struct wl_global *swc_dmabuf_create(struct wl_display *display);
 
+/**
+ * Sets the plane that the surface could be scanned out on, or NULL, and sends
+ * the surface's dmabuf feedback a tranche of the formats that plane supports.
+ */
+void dmabuf_set_scanout_plane(struct surface *surface, struct plane *plane);
+
+/**
+ * Leaves the dmabuf feedback objects of a destroyed surface inert.
+ */
+void dmabuf_detach_feedbacks(struct wl_list *feedbacks);
+
+/**
+ * Brackets reads by the CPU of a buffer that maps a client dmabuf, so that
+ * they see the completed contents, converted first for YUV dmabufs. Other
+ * buffers are left alone.
+ */
+void dmabuf_begin_read(struct wld_buffer *buffer);
+void dmabuf_end_read(struct wld_buffer *buffer);
+
+/**
+ * Returns the explicit modifier of an imported dmabuf, or
+ * DRM_FORMAT_MOD_INVALID if its modifier is implicit.
+ */
+uint64_t dmabuf_get_modifier(struct wld_buffer *buffer);
+
+/**
+ * Marks a region of a buffer that maps a YUV dmabuf, in buffer coordinates,
+ * to be converted again before it is next read.
+ */
+void dmabuf_damage(struct wld_buffer *buffer, pixman_region32_t *damage);
+
+/**
+ * Returns the planes of a buffer that maps a YUV dmabuf, which can be used to
+ * scan it out, or NULL for other buffers.
+ */
+const struct dmabuf_planes *dmabuf_get_planes(struct wld_buffer *buffer);
+
 #endif
@@ -42,6 +42,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <drm.h>
+#include <drm_fourcc.h>
 #include <xf86drm.h>
 #include <wld/wld.h>
 #include <wld/drm.h>
@@ -56,6 +57,9 @@ static struct {
 	struct wl_global *global;
 	struct wl_global *dmabuf;
 	struct wl_event_source *event_source;
+
+	/* The GEM handles of YUV framebuffers, as struct gem_handle. */
+	struct wl_array handles;
 } drm;
 
 static void
@@ -204,8 +208,9 @@ static void
 handle_page_flip(int fd, unsigned int sequence, unsigned int sec, unsigned int usec, unsigned int crtc_id, void *data)
 {
 	struct drm_handler *handler = data;
+	struct timespec time = { .tv_sec = sec, .tv_nsec = usec * 1000 };
 
-	handler->page_flip(handler, sec * 1000 + usec / 1000);
+	handler->page_flip(handler, &time, sequence);
 }
 
 static drmEventContext event_context = {
@@ -261,6 +266,24 @@ drm_initialize(void)
 		ERROR("Could not enable DRM universal planes\n");
 		goto error1;
 	}
+	swc.drm->atomic = drmSetClientCap(swc.drm->fd, DRM_CLIENT_CAP_ATOMIC, 1) == 0;
+	if (!swc.drm->atomic) {
+		WARNING("Atomic modesetting is not supported, using legacy interface\n");
+		swc.drm->async_flip = drmGetCap(swc.drm->fd, DRM_CAP_ASYNC_PAGE_FLIP, &val) == 0 && val;
+	} else {
+#ifdef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+		swc.drm->async_flip = drmGetCap(swc.drm->fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &val) == 0 && val;
+#else
+		swc.drm->async_flip = false;
+#endif
+	}
+	/* Cleared if the driver turns out not to implement DirtyFB. */
+	swc.drm->dirty_fb = !swc.drm->atomic;
+	if (drmGetCap(swc.drm->fd, DRM_CAP_TIMESTAMP_MONOTONIC, &val) < 0 || !val)
+		swc.drm->clock = CLOCK_REALTIME;
+	else
+		swc.drm->clock = CLOCK_MONOTONIC;
+	swc.drm->fb_modifiers = drmGetCap(swc.drm->fd, DRM_CAP_ADDFB2_MODIFIERS, &val) == 0 && val;
 	if (drmGetCap(swc.drm->fd, DRM_CAP_CURSOR_WIDTH, &val) < 0)
 		val = 64;
 	swc.drm->cursor_w = val;
@@ -297,11 +320,12 @@ drm_initialize(void)
 			ERROR("Could not create wl_drm global\n");
 			goto error4;
 		}
+	}
 
-		drm.dmabuf = swc_dmabuf_create(swc.display);
-		if (!drm.dmabuf) {
-			WARNING("Could not create wp_linux_dmabuf global\n");
-		}
+	/* With dumb buffers, dmabufs are mapped and read by the CPU instead. */
+	drm.dmabuf = swc_dmabuf_create(swc.display);
+	if (!drm.dmabuf) {
+		WARNING("Could not create wp_linux_dmabuf global\n");
 	}
 
 	return true;
@@ -323,20 +347,108 @@ drm_finalize(void)
 {
 	if (drm.global)
 		wl_global_destroy(drm.global);
+	if (drm.dmabuf)
+		wl_global_destroy(drm.dmabuf);
 	wl_event_source_remove(drm.event_source);
 	wld_destroy_renderer(swc.drm->renderer);
 	wld_destroy_context(swc.drm->context);
 	free(drm.path);
+	wl_array_release(&drm.handles);
 	close(swc.drm->fd);
 }
 
+bool
+drm_get_property_ids(uint32_t id, uint32_t type, const char *const names[], uint32_t *ids, uint32_t num_names)
+{
+	drmModeObjectProperties *props;
+	drmModePropertyRes *prop;
+	uint32_t i, j, found = 0;
+
+	if (!(props = drmModeObjectGetProperties(swc.drm->fd, id, type)))
+		return false;
+	memset(ids, 0, num_names * sizeof(ids[0]));
+	for (i = 0; i < props->count_props; ++i) {
+		if (!(prop = drmModeGetProperty(swc.drm->fd, props->props[i])))
+			continue;
+		for (j = 0; j < num_names; ++j) {
+			if (!ids[j] && strcmp(prop->name, names[j]) == 0) {
+				ids[j] = prop->prop_id;
+				++found;
+				break;
+			}
+		}
+		drmModeFreeProperty(prop);
+	}
+	drmModeFreeObjectProperties(props);
+
+	return found == num_names;
+}
+
+bool
+drm_get_property_value(uint32_t id, uint32_t type, const char *name, uint64_t *value)
+{
+	drmModeObjectProperties *props;
+	drmModePropertyRes *prop;
+	uint32_t i;
+	bool found = false;
+
+	if (!(props = drmModeObjectGetProperties(swc.drm->fd, id, type)))
+		return false;
+	for (i = 0; i < props->count_props && !found; ++i) {
+		if (!(prop = drmModeGetProperty(swc.drm->fd, props->props[i])))
+			continue;
+		if (strcmp(prop->name, name) == 0) {
+			*value = props->prop_values[i];
+			found = true;
+		}
+		drmModeFreeProperty(prop);
+	}
+	drmModeFreeObjectProperties(props);
+
+	return found;
+}
+
+/**
+ * Hands out the overlay planes in turn to each screen that can use them, so
+ * that a plane usable on several CRTCs is not claimed by the first screen
+ * while others get none.
+ *
+ * Only screens using atomic commits get overlay planes. Without them, a plane
+ * can't be updated together with the page flip of the primary plane, so its
+ * contents would be out of sync with what is composited below.
+ */
+static void
+assign_overlay_planes(struct wl_list *screens, struct wl_list *planes)
+{
+	struct screen *screen;
+	struct plane *plane;
+	bool assigned;
+
+	do {
+		assigned = false;
+		wl_list_for_each (screen, screens, link) {
+			if (!screen->planes.primary.plane)
+				continue;
+			wl_list_for_each (plane, planes, link) {
+				if (plane->type == DRM_PLANE_TYPE_OVERLAY && plane->possible_crtcs & 1 << screen->id) {
+					wl_list_remove(&plane->link);
+					wl_list_insert(screen->planes.overlays.prev, &plane->link);
+					plane->screen = screen;
+					assigned = true;
+					break;
+				}
+			}
+		}
+	} while (assigned);
+}
+
 bool
 drm_create_screens(struct wl_list *screens)
 {
 	drmModePlaneRes *plane_ids;
 	drmModeRes *resources;
 	drmModeConnector *connector;
-	struct plane *plane, *cursor_plane;
+	struct plane *plane, *next, *primary_plane, *cursor_plane;
 	struct output *output;
 	uint32_t i, taken_crtcs = 0;
 	struct wl_list planes;
@@ -370,6 +482,15 @@ drm_create_screens(struct wl_list *screens)
 				continue;
 			}
 
+			primary_plane = NULL;
+			wl_list_for_each (plane, &planes, link) {
+				if (plane->type == DRM_PLANE_TYPE_PRIMARY && plane->possible_crtcs & 1 << crtc_index) {
+					wl_list_remove(&plane->link);
+					primary_plane = plane;
+					break;
+				}
+			}
+
 			cursor_plane = NULL;
 			wl_list_for_each (plane, &planes, link) {
 				if (plane->type == DRM_PLANE_TYPE_CURSOR && plane->possible_crtcs & 1 << crtc_index) {
@@ -385,7 +506,7 @@ drm_create_screens(struct wl_list *screens)
 			if (!(output = output_new(connector)))
 				continue;
 
-			output->screen = screen_new(resources->crtcs[crtc_index], output, cursor_plane);
+			output->screen = screen_new(resources->crtcs[crtc_index], output, primary_plane, cursor_plane);
 			output->screen->id = crtc_index;
 			taken_crtcs |= 1 << crtc_index;
 
@@ -394,6 +515,10 @@ drm_create_screens(struct wl_list *screens)
 	}
 	drmModeFreeResources(resources);
 
+	assign_overlay_planes(screens, &planes);
+	wl_list_for_each_safe (plane, next, &planes, link)
+		plane_destroy(plane);
+
 	return true;
 }
 
@@ -405,8 +530,63 @@ struct framebuffer {
 	struct wld_exporter exporter;
 	struct wld_destructor destructor;
 	uint32_t id;
+
+	/* The GEM handles of the planes of a YUV framebuffer, which are kept
+	 * until the framebuffer is removed. */
+	uint32_t handles[4], num_handles;
+};
+
+/* Importing a dmabuf whose buffer object already has a GEM handle gives that
+ * same handle, so handles are shared between framebuffers and only closed
+ * with the last one using them. */
+struct gem_handle {
+	uint32_t handle;
+	unsigned references;
 };
 
+static bool
+reference_handle(uint32_t handle)
+{
+	struct gem_handle *entry;
+
+	wl_array_for_each (entry, &drm.handles) {
+		if (entry->handle == handle) {
+			++entry->references;
+			return true;
+		}
+	}
+	if (!(entry = wl_array_add(&drm.handles, sizeof(*entry))))
+		return false;
+	entry->handle = handle;
+	entry->references = 1;
+
+	return true;
+}
+
+static void
+unreference_handle(uint32_t handle)
+{
+	struct gem_handle *entry;
+
+	wl_array_for_each (entry, &drm.handles) {
+		if (entry->handle != handle)
+			continue;
+		if (--entry->references == 0) {
+			drmIoctl(swc.drm->fd, DRM_IOCTL_GEM_CLOSE, &(struct drm_gem_close){ .handle = handle });
+			*entry = *(struct gem_handle *)((char *)drm.handles.data + drm.handles.size - sizeof(*entry));
+			drm.handles.size -= sizeof(*entry);
+		}
+		break;
+	}
+}
+
+static void
+release_handles(struct framebuffer *framebuffer)
+{
+	while (framebuffer->num_handles > 0)
+		unreference_handle(framebuffer->handles[--framebuffer->num_handles]);
+}
+
 static bool
 framebuffer_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
 {
@@ -428,37 +608,97 @@ framebuffer_destroy(struct wld_destructor *destructor)
 {
 	struct framebuffer *framebuffer = wl_container_of(destructor, framebuffer, destructor);
 
-	drmModeRmFB(swc.drm->fd, framebuffer->id);
+	if (framebuffer->id)
+		drmModeRmFB(swc.drm->fd, framebuffer->id);
+	release_handles(framebuffer);
 	free(framebuffer);
 }
 
+/**
+ * Creates a framebuffer scanning out the planes of a YUV dmabuf directly.
+ */
+static int
+add_planar_framebuffer(struct wld_buffer *buffer, const struct dmabuf_planes *planes, struct framebuffer *framebuffer)
+{
+	uint64_t modifiers[4] = { 0 };
+	uint32_t handle, i;
+
+	/* The framebuffer holds its own references to the buffer objects, but
+	 * the handles may also be in use by others, so they are kept. */
+	for (i = 0; i < planes->num_planes; ++i) {
+		if (drmPrimeFDToHandle(swc.drm->fd, planes->fd[i], &handle) < 0)
+			return -errno;
+		if (!reference_handle(handle)) {
+			/* The handle was new, since it is otherwise found. */
+			drmIoctl(swc.drm->fd, DRM_IOCTL_GEM_CLOSE, &(struct drm_gem_close){ .handle = handle });
+			return -ENOMEM;
+		}
+		framebuffer->handles[framebuffer->num_handles++] = handle;
+		modifiers[i] = planes->modifier;
+	}
+
+	if (planes->modifier == DRM_FORMAT_MOD_INVALID) {
+		return drmModeAddFB2(swc.drm->fd, buffer->width, buffer->height, planes->format,
+		                     framebuffer->handles, planes->stride, planes->offset, &framebuffer->id, 0);
+	}
+	if (!swc.drm->fb_modifiers)
+		return -EINVAL;
+
+	return drmModeAddFB2WithModifiers(swc.drm->fd, buffer->width, buffer->height, planes->format,
+	                                  framebuffer->handles, planes->stride, planes->offset, modifiers,
+	                                  &framebuffer->id, DRM_MODE_FB_MODIFIERS);
+}
+
 uint32_t
 drm_get_framebuffer(struct wld_buffer *buffer)
 {
 	struct framebuffer *framebuffer;
+	const struct dmabuf_planes *planes;
 	union wld_object object;
+	uint64_t modifier;
 	int ret;
 
-	if (!buffer)
+	if (!buffer || swc.headless)
 		return 0;
 
 	if (wld_export(buffer, WLD_USER_OBJECT_FRAMEBUFFER, &object))
 		return object.u32;
 
-	if (!wld_export(buffer, WLD_DRM_OBJECT_HANDLE, &object)) {
-		ERROR("Could not get buffer handle\n");
+	/* Not every buffer is a DRM buffer; callers use this to check whether a
+	 * buffer can be scanned out at all. */
+	planes = dmabuf_get_planes(buffer);
+	if (!planes && !wld_export(buffer, WLD_DRM_OBJECT_HANDLE, &object)) {
+		DEBUG("Could not get buffer handle\n");
 		return 0;
 	}
 
 	if (!(framebuffer = malloc(sizeof(*framebuffer))))
 		return 0;
-
-	ret = drmModeAddFB2(swc.drm->fd, buffer->width, buffer->height, buffer->format,
-	                    (uint32_t[4]){object.u32}, (uint32_t[4]){buffer->pitch}, (uint32_t[4]){0},
-	                    &framebuffer->id, 0);
+	/* Handles of unused planes must be zero. */
+	memset(framebuffer->handles, 0, sizeof(framebuffer->handles));
+	framebuffer->num_handles = 0;
+
+	/* Buffers with an implicit modifier, including all of our own, are laid
+	 * out as the kernel driver assumes. */
+	modifier = dmabuf_get_modifier(buffer);
+	if (planes) {
+		ret = add_planar_framebuffer(buffer, planes, framebuffer);
+	} else if (modifier == DRM_FORMAT_MOD_INVALID) {
+		ret = drmModeAddFB2(swc.drm->fd, buffer->width, buffer->height, buffer->format,
+		                    (uint32_t[4]){object.u32}, (uint32_t[4]){buffer->pitch}, (uint32_t[4]){0},
+		                    &framebuffer->id, 0);
+	} else if (swc.drm->fb_modifiers) {
+		ret = drmModeAddFB2WithModifiers(swc.drm->fd, buffer->width, buffer->height, buffer->format,
+		                                 (uint32_t[4]){object.u32}, (uint32_t[4]){buffer->pitch}, (uint32_t[4]){0},
+		                                 (uint64_t[4]){modifier}, &framebuffer->id, DRM_MODE_FB_MODIFIERS);
+	} else {
+		ret = -EINVAL;
+	}
 	if (ret < 0) {
-		free(framebuffer);
-		return 0;
+		/* Remember the failure so that we don't retry for every frame. */
+		DEBUG("Could not create framebuffer: %s\n", strerror(-ret));
+		framebuffer->id = 0;
+		release_handles(framebuffer);
 	}
 
 	framebuffer->exporter.export = &framebuffer_export;
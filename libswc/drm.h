@@ -3,17 +3,28 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 struct wl_list;
 struct wld_buffer;
 
 struct drm_handler {
-	void (*page_flip)(struct drm_handler *handler, uint32_t time);
+	void (*page_flip)(struct drm_handler *handler, const struct timespec *time, uint32_t sequence);
 };
 
 struct swc_drm {
 	int fd;
 	uint32_t cursor_w, cursor_h;
+	bool atomic;
+	/* Whether page flips can be done without waiting for the vertical blank. */
+	bool async_flip;
+	/* Whether damage to the scanned out framebuffer is reported with
+	 * DirtyFB. Atomic commits use the FB_DAMAGE_CLIPS plane property. */
+	bool dirty_fb;
+	/* Whether framebuffers can be created with explicit modifiers. */
+	bool fb_modifiers;
+	/* The clock used for page flip timestamps. */
+	clockid_t clock;
 	struct wld_context *context;
 	struct wld_renderer *renderer;
 };
@@ -24,4 +35,18 @@ void drm_finalize(void);
 bool drm_create_screens(struct wl_list *screens);
 uint32_t drm_get_framebuffer(struct wld_buffer *buffer);
 
+/**
+ * Looks up the IDs of the named properties of a DRM object.
+ *
+ * @return Whether or not the object has all of the properties.
+ */
+bool drm_get_property_ids(uint32_t id, uint32_t type, const char *const names[], uint32_t *ids, uint32_t num_names);
+
+/**
+ * Reads the current value of the named property of a DRM object.
+ *
+ * @return Whether or not the object has the property.
+ */
+bool drm_get_property_value(uint32_t id, uint32_t type, const char *name, uint64_t *value);
+
 #endif
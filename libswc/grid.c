@@ -0,0 +1,167 @@
+/* swc: libswc/grid.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "grid.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+
+bool
+grid_initialize(struct grid *grid, const struct swc_rectangle *bounds, uint32_t cell_size)
+{
+	uint32_t i;
+
+	grid->bounds = *bounds;
+	grid->cell_size = cell_size;
+	grid->columns = MAX(1, (bounds->width + cell_size - 1) / cell_size);
+	grid->rows = MAX(1, (bounds->height + cell_size - 1) / cell_size);
+
+	if (!(grid->cells = calloc(grid->columns * grid->rows, sizeof(grid->cells[0]))))
+		return false;
+	for (i = 0; i < grid->columns * grid->rows; ++i)
+		wl_array_init(&grid->cells[i]);
+
+	return true;
+}
+
+void
+grid_finalize(struct grid *grid)
+{
+	uint32_t i;
+
+	for (i = 0; i < grid->columns * grid->rows; ++i)
+		wl_array_release(&grid->cells[i]);
+	free(grid->cells);
+}
+
+/**
+ * Calculates the range of cells overlapped by the area.
+ *
+ * @return Whether or not the area overlaps the grid at all.
+ */
+static bool
+cell_range(struct grid *grid, const struct swc_rectangle *area, uint32_t *x1, uint32_t *y1, uint32_t *x2, uint32_t *y2)
+{
+	int64_t left = (int64_t)area->x - grid->bounds.x, top = (int64_t)area->y - grid->bounds.y;
+	int64_t right = left + area->width, bottom = top + area->height;
+
+	if (area->width == 0 || area->height == 0 || right <= 0 || bottom <= 0
+	    || left >= grid->bounds.width || top >= grid->bounds.height)
+		return false;
+
+	*x1 = MAX(left, 0) / grid->cell_size;
+	*y1 = MAX(top, 0) / grid->cell_size;
+	*x2 = MIN((right - 1) / grid->cell_size, grid->columns - 1);
+	*y2 = MIN((bottom - 1) / grid->cell_size, grid->rows - 1);
+
+	return true;
+}
+
+static bool
+cell_insert(struct wl_array *cell, struct grid_item *item)
+{
+	struct grid_item **items;
+	size_t i, count = cell->size / sizeof(*items);
+
+	if (!wl_array_add(cell, sizeof(*items)))
+		return false;
+	items = cell->data;
+	for (i = 0; i < count && items[i]->order < item->order; ++i)
+		;
+	memmove(&items[i + 1], &items[i], (count - i) * sizeof(*items));
+	items[i] = item;
+
+	return true;
+}
+
+static void
+cell_remove(struct wl_array *cell, struct grid_item *item)
+{
+	struct grid_item **items = cell->data;
+	size_t i, count = cell->size / sizeof(*items);
+
+	for (i = 0; i < count; ++i) {
+		if (items[i] == item) {
+			memmove(&items[i], &items[i + 1], (count - i - 1) * sizeof(*items));
+			cell->size -= sizeof(*items);
+			break;
+		}
+	}
+}
+
+bool
+grid_insert(struct grid *grid, struct grid_item *item)
+{
+	uint32_t x, y, x1, y1, x2, y2;
+	bool ret = true;
+
+	grid_remove(grid, item);
+	if (!cell_range(grid, &item->area, &x1, &y1, &x2, &y2))
+		return true;
+
+	item->inserted = true;
+	item->x1 = x1;
+	item->y1 = y1;
+	item->x2 = x2;
+	item->y2 = y2;
+	for (y = y1; y <= y2; ++y) {
+		for (x = x1; x <= x2; ++x)
+			ret = cell_insert(&grid->cells[y * grid->columns + x], item) && ret;
+	}
+
+	return ret;
+}
+
+void
+grid_remove(struct grid *grid, struct grid_item *item)
+{
+	uint32_t x, y;
+
+	if (!item->inserted)
+		return;
+	item->inserted = false;
+
+	for (y = item->y1; y <= item->y2; ++y) {
+		for (x = item->x1; x <= item->x2; ++x)
+			cell_remove(&grid->cells[y * grid->columns + x], item);
+	}
+}
+
+struct grid_item **
+grid_lookup(struct grid *grid, int32_t x, int32_t y, size_t *count)
+{
+	struct wl_array *cell;
+	int64_t dx = (int64_t)x - grid->bounds.x, dy = (int64_t)y - grid->bounds.y;
+
+	if (dx < 0 || dy < 0 || dx >= grid->bounds.width || dy >= grid->bounds.height) {
+		*count = 0;
+		return NULL;
+	}
+
+	cell = &grid->cells[dy / grid->cell_size * grid->columns + dx / grid->cell_size];
+	*count = cell->size / sizeof(struct grid_item *);
+
+	return cell->data;
+}
@@ -0,0 +1,73 @@
+/* swc: libswc/grid.h
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SWC_GRID_H
+#define SWC_GRID_H
+
+#include "swc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct wl_array;
+
+/**
+ * A uniform grid over a fixed area, used to quickly find the items that may
+ * cover a point.
+ */
+struct grid {
+	struct swc_rectangle bounds;
+	uint32_t cell_size, columns, rows;
+	/* Each cell is an array of the items overlapping it, sorted by order. */
+	struct wl_array *cells;
+};
+
+struct grid_item {
+	/* The area covered by the item, in the same coordinates as the bounds. */
+	struct swc_rectangle area;
+	/* Items with a lower order are returned first. */
+	uint64_t order;
+
+	/* The range of cells the item was inserted into. */
+	bool inserted;
+	uint32_t x1, y1, x2, y2;
+};
+
+bool grid_initialize(struct grid *grid, const struct swc_rectangle *bounds, uint32_t cell_size);
+void grid_finalize(struct grid *grid);
+
+/**
+ * Inserts the item into the cells overlapping its area, or moves it to them
+ * if it is already in the grid. This must be called again after the item's
+ * area or order changes.
+ */
+bool grid_insert(struct grid *grid, struct grid_item *item);
+void grid_remove(struct grid *grid, struct grid_item *item);
+
+/**
+ * Returns the items of the cell containing the point, sorted by order.
+ */
+struct grid_item **grid_lookup(struct grid *grid, int32_t x, int32_t y, size_t *count);
+
+#endif
@@ -0,0 +1,145 @@
+/* swc: libswc/headless.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "headless.h"
+#include "drm.h"
+#include "internal.h"
+#include "output.h"
+#include "screen.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wld/wld.h>
+#include <wld/pixman.h>
+#include <xf86drmMode.h>
+
+#define DEFAULT_SCREENS "1920x1080@60"
+
+bool
+headless_initialize(void)
+{
+	swc.drm->fd = -1;
+	swc.drm->atomic = false;
+	swc.drm->async_flip = false;
+	swc.drm->dirty_fb = false;
+	swc.drm->clock = CLOCK_MONOTONIC;
+	swc.drm->cursor_w = 64;
+	swc.drm->cursor_h = 64;
+
+	if (!(swc.drm->context = wld_pixman_create_context())) {
+		ERROR("Could not create pixman context\n");
+		goto error0;
+	}
+
+	if (!(swc.drm->renderer = wld_create_renderer(swc.drm->context))) {
+		ERROR("Could not create pixman renderer\n");
+		goto error1;
+	}
+
+	return true;
+
+error1:
+	wld_destroy_context(swc.drm->context);
+error0:
+	return false;
+}
+
+void
+headless_finalize(void)
+{
+	wld_destroy_renderer(swc.drm->renderer);
+	wld_destroy_context(swc.drm->context);
+}
+
+static bool
+parse_mode(const char *spec, drmModeModeInfo *info)
+{
+	unsigned width, height, refresh = 60;
+	int n;
+
+	if (sscanf(spec, "%ux%u%n@%u%n", &width, &height, &n, &refresh, &n) < 2)
+		return false;
+	if (spec[n] != '\0' && spec[n] != ',')
+		return false;
+	if (width == 0 || height == 0 || width > UINT16_MAX || height > UINT16_MAX || refresh == 0)
+		return false;
+
+	memset(info, 0, sizeof(*info));
+	info->hdisplay = width;
+	info->vdisplay = height;
+	info->vrefresh = refresh;
+	info->type = DRM_MODE_TYPE_PREFERRED;
+	snprintf(info->name, sizeof(info->name), "%ux%u", width, height);
+
+	return true;
+}
+
+static struct screen *
+add_screen(drmModeModeInfo *info)
+{
+	drmModeConnector connector = {.count_modes = 1, .modes = info};
+	struct output *output;
+	struct screen *screen;
+
+	if (!(output = output_new(&connector)))
+		goto error0;
+	if (!(screen = screen_new(0, output, NULL, NULL)))
+		goto error1;
+	output->screen = screen;
+
+	return screen;
+
+error1:
+	output_destroy(output);
+error0:
+	return NULL;
+}
+
+bool
+headless_create_screens(struct wl_list *screens)
+{
+	drmModeModeInfo info;
+	struct screen *screen;
+	const char *spec;
+	size_t len;
+	uint8_t id = 0;
+
+	if (!(spec = getenv("SWC_HEADLESS_SCREENS")))
+		spec = DEFAULT_SCREENS;
+
+	for (; *spec && id < 32; spec += len + (spec[len] == ',')) {
+		len = strcspn(spec, ",");
+		if (!parse_mode(spec, &info)) {
+			ERROR("Invalid headless screen mode '%.*s'\n", (int)len, spec);
+			continue;
+		}
+		if (!(screen = add_screen(&info)))
+			continue;
+		screen->id = id++;
+		wl_list_insert(screens, &screen->link);
+	}
+
+	return true;
+}
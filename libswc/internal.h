@@ -39,6 +39,8 @@ struct swc {
 	const struct swc_manager *manager;
 	struct wl_signal event_signal;
 	bool active;
+	/* Whether screens are virtual rather than backed by DRM. */
+	bool headless;
 
 	struct swc_seat *seat;
 	const struct swc_bindings *const bindings;
@@ -50,9 +52,13 @@ struct swc {
 	struct wl_global *data_device_manager;
 	struct wl_global *kde_decoration_manager;
 	struct wl_global *panel_manager;
+	struct wl_global *presentation;
 	struct wl_global *screenshot_manager;
 	struct wl_global *shell;
+	struct wl_global *single_pixel_buffer_manager;
 	struct wl_global *subcompositor;
+	struct wl_global *tearing_control_manager;
+	struct wl_global *viewporter;
 	struct wl_global *xdg_decoration_manager;
 	struct wl_global *xdg_shell;
 
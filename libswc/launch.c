@@ -36,7 +36,7 @@ static struct {
 	int socket;
 	struct wl_event_source *source;
 	uint32_t next_serial;
-} launch;
+} launch = {.socket = -1};
 
 static bool
 handle_event(struct swc_launch_event *event)
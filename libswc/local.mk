@@ -18,18 +18,21 @@ $(dir)_TARGETS +=                   \
 endif
 
 $(dir)_PACKAGES := libdrm pixman-1 wayland-server wld xkbcommon
-$(dir)_CFLAGS += -Iprotocol
+$(dir)_CFLAGS += -Iprotocol -pthread
 
 SWC_SOURCES =                       \
     launch/protocol.c               \
     libswc/background.c             \
     libswc/bindings.c               \
+    libswc/buffer_pool.c            \
     libswc/compositor.c             \
     libswc/data.c                   \
     libswc/data_device.c            \
     libswc/data_device_manager.c    \
     libswc/dmabuf.c                 \
     libswc/drm.c                    \
+    libswc/grid.c                   \
+    libswc/headless.c               \
     libswc/input.c                  \
     libswc/kde_decoration.c         \
     libswc/keyboard.c               \
@@ -40,6 +43,7 @@ SWC_SOURCES =                       \
     libswc/panel_manager.c          \
     libswc/plane.c                  \
     libswc/pointer.c                \
+    libswc/presentation.c           \
     libswc/primary_plane.c          \
     libswc/region.c                 \
     libswc/screen.c                 \
@@ -47,19 +51,28 @@ SWC_SOURCES =                       \
     libswc/shell.c                  \
     libswc/shell_surface.c          \
     libswc/shm.c                    \
+    libswc/single_pixel_buffer.c    \
     libswc/subcompositor.c          \
     libswc/subsurface.c             \
     libswc/surface.c                \
     libswc/swc.c                    \
+    libswc/tearing_control.c        \
+    libswc/thread_pool.c            \
     libswc/util.c                   \
     libswc/view.c                   \
+    libswc/viewporter.c             \
     libswc/wayland_buffer.c         \
     libswc/window.c                 \
     libswc/xdg_decoration.c         \
     libswc/xdg_shell.c              \
+    libswc/yuv.c                    \
     protocol/linux-dmabuf-unstable-v1-protocol.c \
+    protocol/presentation-time-protocol.c \
     protocol/server-decoration-protocol.c \
+    protocol/single-pixel-buffer-v1-protocol.c \
     protocol/swc-protocol.c         \
+    protocol/tearing-control-v1-protocol.c \
+    protocol/viewporter-protocol.c  \
     protocol/wayland-drm-protocol.c \
     protocol/xdg-decoration-unstable-v1-protocol.c \
     protocol/xdg-shell-protocol.c
@@ -93,6 +106,10 @@ $(call objects,background compositor panel_manager panel screen screenshot): pro
 $(call objects,dmabuf): protocol/linux-dmabuf-unstable-v1-server-protocol.h
 $(call objects,drm drm_buffer): protocol/wayland-drm-server-protocol.h
 $(call objects,kde_decoration): protocol/server-decoration-server-protocol.h
+$(call objects,presentation primary_plane): protocol/presentation-time-server-protocol.h
+$(call objects,single_pixel_buffer): protocol/single-pixel-buffer-v1-server-protocol.h
+$(call objects,tearing_control): protocol/tearing-control-v1-server-protocol.h
+$(call objects,surface viewporter): protocol/viewporter-server-protocol.h
 $(call objects,xdg_decoration): protocol/xdg-decoration-unstable-v1-server-protocol.h
 $(call objects,xdg_shell): protocol/xdg-shell-server-protocol.h
 $(call objects,pointer): cursor/cursor_data.h
@@ -107,7 +124,7 @@ $(dir)/libswc.a: $(dir)/libswc.o
 	$(Q_AR)$(AR) cru $@ $^
 
 $(dir)/$(LIBSWC_LIB): $(SWC_SHARED_OBJECTS)
-	$(link) -shared -Wl,-soname,$(LIBSWC_SO) -Wl,-no-undefined $(libswc_PACKAGE_LIBS)
+	$(link) -shared -Wl,-soname,$(LIBSWC_SO) -Wl,-no-undefined $(libswc_PACKAGE_LIBS) -pthread
 
 $(dir)/$(LIBSWC_SO): $(dir)/$(LIBSWC_LIB)
 	$(Q_SYM)ln -sf $(notdir $<) $@
@@ -30,24 +30,12 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <drm_fourcc.h>
 #include <wld/wld.h>
 #include <wld/drm.h>
 #include <xf86drmMode.h>
 
-enum plane_property {
-	PLANE_TYPE,
-	PLANE_IN_FENCE_FD,
-	PLANE_CRTC_ID,
-	PLANE_CRTC_X,
-	PLANE_CRTC_Y,
-	PLANE_CRTC_W,
-	PLANE_CRTC_H,
-	PLANE_SRC_X,
-	PLANE_SRC_Y,
-	PLANE_SRC_W,
-	PLANE_SRC_H,
-};
-
 static bool
 update(struct view *view)
 {
@@ -56,12 +44,15 @@ update(struct view *view)
 
 	if (!plane->screen)
 		return false;
+	if (plane->screen->planes.primary.plane)
+		return primary_plane_update_plane(&plane->screen->planes.primary, plane);
 	x = view->geometry.x - plane->screen->base.geometry.x;
 	y = view->geometry.y - plane->screen->base.geometry.y;
 	w = view->geometry.width;
 	h = view->geometry.height;
-	if (swc.active && drmModeSetPlane(swc.drm->fd, plane->id, plane->screen->crtc, plane->fb, 0, x, y, w, h, 0, 0, w << 16, h << 16) < 0) {
-		ERROR("Could not set cursor: %s\n", strerror(errno));
+	if (swc.active && drmModeSetPlane(swc.drm->fd, plane->id, plane->screen->crtc, plane->fb, 0, x, y, w, h,
+	                                  plane->src.x, plane->src.y, plane->src.width, plane->src.height) < 0) {
+		ERROR("Could not set plane %u: %s\n", plane->id, strerror(errno));
 		return false;
 	}
 
@@ -75,6 +66,10 @@ attach(struct view *view, struct wld_buffer *buffer)
 
 	plane->fb = drm_get_framebuffer(buffer);
 	view_set_size_from_buffer(view, buffer);
+	plane->src.x = 0;
+	plane->src.y = 0;
+	plane->src.width = view->geometry.width << 16;
+	plane->src.height = view->geometry.height << 16;
 	return 0;
 }
 
@@ -94,9 +89,10 @@ static const struct view_impl view_impl = {
 static enum plane_property
 find_prop(const char *name)
 {
-	static const char property_names[][16] = {
+	static const char property_names[][24] = {
 		[PLANE_TYPE]        = "type",
 		[PLANE_IN_FENCE_FD] = "IN_FENCE_FD",
+		[PLANE_FB_ID]       = "FB_ID",
 		[PLANE_CRTC_ID]     = "CRTC_ID",
 		[PLANE_CRTC_X]      = "CRTC_X",
 		[PLANE_CRTC_Y]      = "CRTC_Y",
@@ -106,6 +102,8 @@ find_prop(const char *name)
 		[PLANE_SRC_Y]       = "SRC_Y",
 		[PLANE_SRC_W]       = "SRC_W",
 		[PLANE_SRC_H]       = "SRC_H",
+		[PLANE_FB_DAMAGE_CLIPS] = "FB_DAMAGE_CLIPS",
+		[PLANE_IN_FORMATS]  = "IN_FORMATS",
 	};
 	size_t i;
 
@@ -129,11 +127,57 @@ handle_swc_event(struct wl_listener *listener, void *data)
 	}
 }
 
+/**
+ * Reads the format-modifier pairs of the plane's IN_FORMATS blob.
+ */
+static bool
+read_modifiers(struct plane *plane, uint32_t blob_id)
+{
+	drmModePropertyBlobRes *blob;
+	struct drm_format_modifier_blob *data;
+	struct drm_format_modifier *modifiers;
+	uint32_t *formats, i, j;
+	size_t size = 0;
+
+	if (!(blob = drmModeGetPropertyBlob(swc.drm->fd, blob_id)))
+		return false;
+	data = blob->data;
+	formats = (uint32_t *)((char *)data + data->formats_offset);
+	modifiers = (struct drm_format_modifier *)((char *)data + data->modifiers_offset);
+
+	/* Each modifier applies to up to 64 formats, starting at its offset. */
+	for (i = 0; i < data->count_modifiers; ++i) {
+		for (j = 0; j < 64; ++j) {
+			if (modifiers[i].formats & (uint64_t)1 << j && modifiers[i].offset + j < data->count_formats)
+				++size;
+		}
+	}
+	plane->modifiers = malloc(size * sizeof(plane->modifiers[0]));
+	if (!plane->modifiers && size > 0) {
+		drmModeFreePropertyBlob(blob);
+		return false;
+	}
+	plane->num_modifiers = 0;
+	for (i = 0; i < data->count_modifiers; ++i) {
+		for (j = 0; j < 64; ++j) {
+			if (!(modifiers[i].formats & (uint64_t)1 << j) || modifiers[i].offset + j >= data->count_formats)
+				continue;
+			plane->modifiers[plane->num_modifiers].format = formats[modifiers[i].offset + j];
+			plane->modifiers[plane->num_modifiers].modifier = modifiers[i].modifier;
+			++plane->num_modifiers;
+		}
+	}
+	drmModeFreePropertyBlob(blob);
+
+	return true;
+}
+
 struct plane *
 plane_new(uint32_t id)
 {
 	struct plane *plane;
 	uint32_t i;
+	int index;
 	drmModeObjectProperties *props;
 	drmModePropertyRes *prop;
 	drmModePlane *drm_plane;
@@ -147,17 +191,38 @@ plane_new(uint32_t id)
 	plane->id = id;
 	plane->fb = 0;
 	plane->screen = NULL;
+	plane->src.x = 0;
+	plane->src.y = 0;
+	plane->src.width = 0;
+	plane->src.height = 0;
 	plane->possible_crtcs = drm_plane->possible_crtcs;
+	plane->formats = malloc(drm_plane->count_formats * sizeof(plane->formats[0]));
+	if (!plane->formats && drm_plane->count_formats > 0) {
+		drmModeFreePlane(drm_plane);
+		goto error1;
+	}
+	memcpy(plane->formats, drm_plane->formats, drm_plane->count_formats * sizeof(plane->formats[0]));
+	plane->num_formats = drm_plane->count_formats;
 	drmModeFreePlane(drm_plane);
+	plane->modifiers = NULL;
+	plane->num_modifiers = 0;
 	plane->type = -1;
+	memset(plane->props, 0, sizeof(plane->props));
 	props = drmModeObjectGetProperties(swc.drm->fd, id, DRM_MODE_OBJECT_PLANE);
 	for (i = 0; i < props->count_props; ++i, drmModeFreeProperty(prop)) {
 		prop = drmModeGetProperty(swc.drm->fd, props->props[i]);
-		if (prop && find_prop(prop->name) == PLANE_TYPE)
+		if (!prop || (index = find_prop(prop->name)) == -1)
+			continue;
+		plane->props[index] = prop->prop_id;
+		if (index == PLANE_TYPE)
 			plane->type = props->prop_values[i];
+		else if (index == PLANE_IN_FORMATS && !read_modifiers(plane, props->prop_values[i]))
+			WARNING("Could not read supported modifiers of plane %u\n", id);
 	}
+	drmModeFreeObjectProperties(props);
 	plane->swc_listener.notify = &handle_swc_event;
 	wl_signal_add(&swc.event_signal, &plane->swc_listener);
+	wl_list_init(&plane->commit_link);
 	view_initialize(&plane->view, &view_impl);
 	return plane;
 
@@ -170,5 +235,88 @@ error0:
 void
 plane_destroy(struct plane *plane)
 {
+	wl_list_remove(&plane->swc_listener.link);
+	wl_list_remove(&plane->commit_link);
+	view_finalize(&plane->view);
+	free(plane->formats);
+	free(plane->modifiers);
 	free(plane);
 }
+
+bool
+plane_supports_format(struct plane *plane, uint32_t format)
+{
+	uint32_t i;
+
+	for (i = 0; i < plane->num_formats; ++i) {
+		if (plane->formats[i] == format)
+			return true;
+	}
+	return false;
+}
+
+bool
+plane_supports_modifier(struct plane *plane, uint32_t format, uint64_t modifier)
+{
+	uint32_t i;
+
+	if (modifier == DRM_FORMAT_MOD_INVALID)
+		return plane_supports_format(plane, format);
+	for (i = 0; i < plane->num_modifiers; ++i) {
+		if (plane->modifiers[i].format == format && plane->modifiers[i].modifier == modifier)
+			return true;
+	}
+	return false;
+}
+
+bool
+plane_supports_tiling(struct plane *plane, uint32_t format)
+{
+	uint32_t i;
+
+	for (i = 0; i < plane->num_modifiers; ++i) {
+		if (plane->modifiers[i].format == format && plane->modifiers[i].modifier != DRM_FORMAT_MOD_LINEAR
+		    && plane->modifiers[i].modifier != DRM_FORMAT_MOD_INVALID)
+			return true;
+	}
+	return false;
+}
+
+void
+plane_set_viewport(struct plane *plane, uint32_t src_x, uint32_t src_y, uint32_t src_width, uint32_t src_height,
+                   uint32_t width, uint32_t height)
+{
+	plane->src.x = src_x;
+	plane->src.y = src_y;
+	plane->src.width = src_width;
+	plane->src.height = src_height;
+	view_set_size(&plane->view, width, height);
+}
+
+bool
+plane_add_properties(struct plane *plane, drmModeAtomicReq *req)
+{
+	const struct swc_rectangle *geom = &plane->view.geometry;
+	uint64_t values[PLANE_NUM_PROPERTIES] = { 0 };
+	int i;
+
+	if (plane->fb) {
+		values[PLANE_FB_ID] = plane->fb;
+		values[PLANE_CRTC_ID] = plane->screen->crtc;
+		values[PLANE_CRTC_X] = geom->x - plane->screen->base.geometry.x;
+		values[PLANE_CRTC_Y] = geom->y - plane->screen->base.geometry.y;
+		values[PLANE_CRTC_W] = geom->width;
+		values[PLANE_CRTC_H] = geom->height;
+		values[PLANE_SRC_X] = plane->src.x;
+		values[PLANE_SRC_Y] = plane->src.y;
+		values[PLANE_SRC_W] = plane->src.width;
+		values[PLANE_SRC_H] = plane->src.height;
+	}
+
+	for (i = PLANE_FB_ID; i <= PLANE_SRC_H; ++i) {
+		if (drmModeAtomicAddProperty(req, plane->id, plane->props[i], values[i]) < 0)
+			return false;
+	}
+
+	return true;
+}
@@ -28,6 +28,27 @@
 #include "view.h"
 
 #include <wayland-server.h>
+#include <xf86drmMode.h>
+
+enum plane_property {
+	PLANE_TYPE,
+	PLANE_IN_FENCE_FD,
+	PLANE_FB_ID,
+	PLANE_CRTC_ID,
+	PLANE_CRTC_X,
+	PLANE_CRTC_Y,
+	PLANE_CRTC_W,
+	PLANE_CRTC_H,
+	PLANE_SRC_X,
+	PLANE_SRC_Y,
+	PLANE_SRC_W,
+	PLANE_SRC_H,
+	/* Optional; only set with framebuffers that have known damage. */
+	PLANE_FB_DAMAGE_CLIPS,
+	/* Read-only; the format-modifier pairs the plane supports. */
+	PLANE_IN_FORMATS,
+	PLANE_NUM_PROPERTIES,
+};
 
 struct plane {
 	struct view view;
@@ -35,11 +56,60 @@ struct plane {
 	uint32_t id, fb;
 	int type;
 	uint32_t possible_crtcs;
+	uint32_t *formats, num_formats;
+	uint32_t props[PLANE_NUM_PROPERTIES];
+
+	/* The format-modifier pairs of the plane's IN_FORMATS property. If the
+	 * plane doesn't have it, only implicit modifiers are supported. */
+	struct plane_modifier {
+		uint32_t format;
+		uint64_t modifier;
+	} *modifiers;
+	uint32_t num_modifiers;
+
+	/* The part of the framebuffer scanned out, in 16.16 fixed point, which
+	 * is scaled to the size of the view. */
+	struct {
+		uint32_t x, y, width, height;
+	} src;
+
 	struct wl_listener swc_listener;
 	struct wl_list link;
+
+	/* Link in the primary plane's list of planes to include in its next
+	 * atomic commit. */
+	struct wl_list commit_link;
 };
 
 struct plane *plane_new(uint32_t id);
 void plane_destroy(struct plane *plane);
+bool plane_supports_format(struct plane *plane, uint32_t format);
+
+/**
+ * Returns whether the plane can scan out framebuffers of the format with the
+ * modifier, which may be DRM_FORMAT_MOD_INVALID for an implicit modifier.
+ */
+bool plane_supports_modifier(struct plane *plane, uint32_t format, uint64_t modifier);
+
+/**
+ * Returns whether the plane can scan out framebuffers of the format in a
+ * tiled or compressed layout.
+ */
+bool plane_supports_tiling(struct plane *plane, uint32_t format);
+
+/**
+ * Sets the part of the attached framebuffer to scan out, in 16.16 fixed point,
+ * and the size to scale it to. Attaching a new framebuffer resets both to
+ * those of the framebuffer.
+ */
+void plane_set_viewport(struct plane *plane, uint32_t src_x, uint32_t src_y, uint32_t src_width, uint32_t src_height,
+                        uint32_t width, uint32_t height);
+
+/**
+ * Adds the plane's current state to an atomic request.
+ *
+ * @return Whether or not all properties were added.
+ */
+bool plane_add_properties(struct plane *plane, drmModeAtomicReq *req);
 
 #endif
@@ -78,7 +78,7 @@ handle_cursor_surface_destroy(struct wl_listener *listener, void *data)
 static bool
 update(struct view *view)
 {
-	view_frame(view, get_time());
+	view_frame(view, NULL);
 	return true;
 }
 
@@ -100,15 +100,18 @@ attach(struct view *view, struct wld_buffer *buffer)
 
 	wld_flush(swc.shm->renderer);
 
-	if (surface)
+	if (surface) {
 		pixman_region32_clear(&surface->state.damage);
-
-	/* TODO: Send an early release to the buffer */
+		/* The cursor buffer now holds the cursor image. */
+		surface_release_buffer(surface);
+	}
 
 	if (view_set_size_from_buffer(view, buffer))
 		view_update_screens(view);
 
 	wl_list_for_each (screen, &swc.screens, link) {
+		if (!screen->planes.cursor)
+			continue;
 		view_attach(&screen->planes.cursor->view, buffer ? pointer->cursor.buffer : NULL);
 		view_update(&screen->planes.cursor->view);
 	}
@@ -125,6 +128,8 @@ move(struct view *view, int32_t x, int32_t y)
 		view_update_screens(view);
 
 	wl_list_for_each (screen, &swc.screens, link) {
+		if (!screen->planes.cursor)
+			continue;
 		view_move(&screen->planes.cursor->view, view->geometry.x, view->geometry.y);
 		view_update(&screen->planes.cursor->view);
 	}
@@ -285,8 +290,10 @@ pointer_initialize(struct pointer *pointer)
 
 	pointer_set_cursor(pointer, cursor_left_ptr);
 
-	wl_list_for_each (screen, &swc.screens, link)
-		view_attach(&screen->planes.cursor->view, pointer->cursor.buffer);
+	wl_list_for_each (screen, &swc.screens, link) {
+		if (screen->planes.cursor)
+			view_attach(&screen->planes.cursor->view, pointer->cursor.buffer);
+	}
 
 	input_focus_initialize(&pointer->focus, &pointer->focus_handler);
 	pixman_region32_init(&pointer->region);
@@ -0,0 +1,120 @@
+/* swc: libswc/presentation.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "presentation.h"
+#include "drm.h"
+#include "internal.h"
+#include "output.h"
+#include "screen.h"
+#include "surface.h"
+#include "util.h"
+#include "view.h"
+
+#include "presentation-time-server-protocol.h"
+
+static void
+feedback(struct wl_client *client, struct wl_resource *resource, struct wl_resource *surface_resource, uint32_t id)
+{
+	struct surface *surface = wl_resource_get_user_data(surface_resource);
+	struct wl_resource *feedback_resource;
+
+	feedback_resource = wl_resource_create(client, &wp_presentation_feedback_interface, 1, id);
+	if (!feedback_resource) {
+		wl_resource_post_no_memory(resource);
+		return;
+	}
+	wl_resource_set_implementation(feedback_resource, NULL, NULL, &remove_resource);
+	wl_list_insert(surface->pending.state.feedbacks.prev, wl_resource_get_link(feedback_resource));
+}
+
+static const struct wp_presentation_interface presentation_impl = {
+	.destroy = destroy_resource,
+	.feedback = feedback,
+};
+
+static void
+bind_presentation(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+	struct wl_resource *resource;
+
+	resource = wl_resource_create(client, &wp_presentation_interface, version, id);
+	if (!resource) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &presentation_impl, NULL, NULL);
+	wp_presentation_send_clock_id(resource, swc.drm->clock);
+}
+
+struct wl_global *
+presentation_create(struct wl_display *display)
+{
+	return wl_global_create(display, &wp_presentation_interface, 1, NULL, &bind_presentation);
+}
+
+static void
+send_sync_output(struct wl_resource *resource, struct screen *screen)
+{
+	struct wl_client *client = wl_resource_get_client(resource);
+	struct wl_resource *output_resource;
+	struct output *output;
+
+	wl_list_for_each (output, &screen->outputs, link) {
+		output_resource = wl_resource_find_for_client(&output->resources, client);
+		if (output_resource)
+			wp_presentation_feedback_send_sync_output(resource, output_resource);
+	}
+}
+
+void
+presentation_send_presented(struct wl_list *feedbacks, const struct frame_info *info)
+{
+	struct wl_resource *resource, *tmp;
+	struct frame_info now = { 0 };
+	uint64_t sec;
+
+	if (!info) {
+		clock_gettime(swc.drm->clock, &now.time);
+		info = &now;
+	}
+	sec = info->time.tv_sec;
+
+	wl_list_for_each_safe (resource, tmp, feedbacks, link) {
+		if (info->screen)
+			send_sync_output(resource, info->screen);
+		wp_presentation_feedback_send_presented(resource, sec >> 32, sec & 0xffffffff, info->time.tv_nsec, info->refresh,
+		                                        info->sequence >> 32, info->sequence & 0xffffffff, info->flags);
+		wl_resource_destroy(resource);
+	}
+}
+
+void
+presentation_send_discarded(struct wl_list *feedbacks)
+{
+	struct wl_resource *resource, *tmp;
+
+	wl_list_for_each_safe (resource, tmp, feedbacks, link) {
+		wp_presentation_feedback_send_discarded(resource);
+		wl_resource_destroy(resource);
+	}
+}
@@ -0,0 +1,47 @@
+/* swc: libswc/presentation.h
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SWC_PRESENTATION_H
+#define SWC_PRESENTATION_H
+
+struct frame_info;
+struct wl_display;
+struct wl_list;
+
+struct wl_global *presentation_create(struct wl_display *display);
+
+/**
+ * Sends a presented event for the frame to each feedback resource in the list,
+ * destroying them.
+ *
+ * If info is NULL, the current time is used.
+ */
+void presentation_send_presented(struct wl_list *feedbacks, const struct frame_info *info);
+
+/**
+ * Sends a discarded event to each feedback resource in the list, destroying
+ * them.
+ */
+void presentation_send_discarded(struct wl_list *feedbacks);
+
+#endif
@@ -26,14 +26,19 @@
 #include "event.h"
 #include "internal.h"
 #include "launch.h"
+#include "plane.h"
+#include "screen.h"
 #include "util.h"
 
+#include "presentation-time-server-protocol.h"
 #include <errno.h>
 #include <wld/wld.h>
 #include <wld/drm.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#define MAX_DAMAGE_RECTS 64
+
 static bool
 update(struct view *view)
 {
@@ -45,17 +50,352 @@ send_frame(void *data)
 {
 	struct primary_plane *plane = data;
 
-	view_frame(&plane->view, get_time());
+	view_frame(&plane->view, NULL);
+	plane->discarded = false;
+}
+
+static int
+add_modeset(struct primary_plane *plane, drmModeAtomicReq *req, uint32_t *mode_blob)
+{
+	static const char *const connector_property_names[] = { "CRTC_ID" };
+	uint32_t *connector, prop;
+	int ret;
+
+	ret = drmModeCreatePropertyBlob(swc.drm->fd, &plane->mode.info, sizeof(plane->mode.info), mode_blob);
+	if (ret < 0)
+		return ret;
+	if (drmModeAtomicAddProperty(req, plane->crtc, plane->crtc_props[CRTC_MODE_ID], *mode_blob) < 0
+	    || drmModeAtomicAddProperty(req, plane->crtc, plane->crtc_props[CRTC_ACTIVE], 1) < 0)
+		return -ENOMEM;
+	wl_array_for_each (connector, &plane->connectors) {
+		if (!drm_get_property_ids(*connector, DRM_MODE_OBJECT_CONNECTOR, connector_property_names, &prop, 1))
+			return -EINVAL;
+		if (drmModeAtomicAddProperty(req, *connector, prop, plane->crtc) < 0)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * Commits the pending framebuffer and plane states in a single nonblocking
+ * atomic request. If a commit is already in progress, this is deferred until
+ * its page flip event arrives.
+ */
+static int
+commit(struct primary_plane *plane)
+{
+	drmModeAtomicReq *req;
+	struct plane *other, *next;
+	uint32_t flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, mode_blob = 0, damage_blob = 0;
+	int ret = 0;
+
+	if (plane->committing)
+		return 0;
+	if (!swc.active) {
+		/* Nothing can be displayed, but the compositor still waits for the
+		 * frame of the framebuffer it attached. */
+		if (plane->fb_pending) {
+			plane->fb_pending = false;
+			wl_event_loop_add_idle(swc.event_loop, &send_frame, plane);
+		}
+		return 0;
+	}
+	/* A modeset needs a framebuffer for the primary plane. */
+	if (plane->need_modeset && !plane->fb_pending)
+		return 0;
+	if (!plane->fb_pending && !plane->vrr_pending && wl_list_empty(&plane->dirty_planes))
+		return 0;
+
+	if (!(req = drmModeAtomicAlloc()))
+		return -ENOMEM;
+
+	if (plane->need_modeset) {
+		if ((ret = add_modeset(plane, req, &mode_blob)) < 0)
+			goto done;
+		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+	}
+	/* Another DRM master may have changed VRR_ENABLED while we were inactive. */
+	if (plane->vrr_prop && (plane->vrr_pending || flags & DRM_MODE_ATOMIC_ALLOW_MODESET)) {
+		if (drmModeAtomicAddProperty(req, plane->crtc, plane->vrr_prop, plane->vrr) < 0) {
+			ret = -ENOMEM;
+			goto done;
+		}
+	}
+	if (plane->fb_pending) {
+		plane->plane->fb = plane->fb;
+		plane->plane->view.geometry = plane->view.geometry;
+		if (!plane_add_properties(plane->plane, req)) {
+			ret = -ENOMEM;
+			goto done;
+		}
+		/* Damage clips are only a hint, so the commit goes ahead without
+		 * them if the blob can't be created. */
+		if (plane->damage.size > 0 && plane->plane->props[PLANE_FB_DAMAGE_CLIPS]
+		    && drmModeCreatePropertyBlob(swc.drm->fd, plane->damage.data, plane->damage.size, &damage_blob) == 0
+		    && drmModeAtomicAddProperty(req, plane->plane->id, plane->plane->props[PLANE_FB_DAMAGE_CLIPS], damage_blob) < 0) {
+			ret = -ENOMEM;
+			goto done;
+		}
+	}
+	wl_list_for_each (other, &plane->dirty_planes, commit_link) {
+		if (!plane_add_properties(other, req)) {
+			ret = -ENOMEM;
+			goto done;
+		}
+	}
+
+	/* Asynchronous commits may only change the primary plane's framebuffer. */
+	if (plane->async && swc.drm->async_flip && plane->fb_pending && !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET) && !plane->vrr_pending && wl_list_empty(&plane->dirty_planes))
+		flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+
+	ret = drmModeAtomicCommit(swc.drm->fd, req, flags, &plane->drm_handler);
+	if (ret < 0 && flags & DRM_MODE_PAGE_FLIP_ASYNC) {
+		DEBUG("Asynchronous commit failed, falling back to vsync\n");
+		flags &= ~DRM_MODE_PAGE_FLIP_ASYNC;
+		ret = drmModeAtomicCommit(swc.drm->fd, req, flags, &plane->drm_handler);
+	}
+	if (ret < 0) {
+		ERROR("Atomic commit on CRTC %u failed: %s\n", plane->crtc, strerror(-ret));
+		goto done;
+	}
+
+	plane->committing = true;
+	plane->committed_fb = plane->fb_pending;
+	plane->flipped_async = flags & DRM_MODE_PAGE_FLIP_ASYNC;
+	plane->need_modeset = false;
+
+done:
+	/* Failed state is dropped rather than retried on every commit. */
+	plane->fb_pending = false;
+	plane->vrr_pending = false;
+	plane->damage.size = 0;
+	wl_list_for_each_safe (other, next, &plane->dirty_planes, commit_link) {
+		wl_list_remove(&other->commit_link);
+		wl_list_init(&other->commit_link);
+	}
+	if (mode_blob)
+		drmModeDestroyPropertyBlob(swc.drm->fd, mode_blob);
+	if (damage_blob)
+		drmModeDestroyPropertyBlob(swc.drm->fd, damage_blob);
+	drmModeAtomicFree(req);
+	return ret;
+}
+
+/**
+ * Commits state that was deferred while another commit was in progress. The
+ * compositor already waits for the frame of a deferred framebuffer, so if it
+ * can't be committed, the frame is completed without it.
+ */
+static void
+commit_deferred(struct primary_plane *plane)
+{
+	bool fb_pending = plane->fb_pending;
+
+	if (commit(plane) < 0 && fb_pending) {
+		plane->discarded = true;
+		wl_event_loop_add_idle(swc.event_loop, &send_frame, plane);
+	}
+}
+
+static void
+handle_commit_idle(void *data)
+{
+	struct primary_plane *plane = data;
+
+	plane->commit_idle = NULL;
+	commit_deferred(plane);
+}
+
+static void
+schedule_commit(struct primary_plane *plane)
+{
+	if (!plane->committing && !plane->commit_idle)
+		plane->commit_idle = wl_event_loop_add_idle(swc.event_loop, &handle_commit_idle, plane);
+}
+
+/**
+ * Tests whether the plane's state can be committed together with the primary
+ * plane's framebuffer and the other plane states queued for the next commit.
+ */
+static int
+test_plane(struct primary_plane *primary, struct plane *plane)
+{
+	drmModeAtomicReq *req;
+	struct plane *other;
+	bool added;
+	int ret;
+
+	if (!(req = drmModeAtomicAlloc()))
+		return -ENOMEM;
+	added = plane_add_properties(plane, req);
+	if (added && plane != primary->plane && primary->plane->fb)
+		added = plane_add_properties(primary->plane, req);
+	wl_list_for_each (other, &primary->dirty_planes, commit_link) {
+		if (added && other != plane)
+			added = plane_add_properties(other, req);
+	}
+	if (added)
+		ret = drmModeAtomicCommit(swc.drm->fd, req, DRM_MODE_ATOMIC_TEST_ONLY, NULL);
+	else
+		ret = -ENOMEM;
+	drmModeAtomicFree(req);
+
+	return ret;
+}
+
+bool
+primary_plane_update_plane(struct primary_plane *plane, struct plane *other)
+{
+	/* Overlays can't be tested before the CRTC is set up by a modeset, so
+	 * their views are composited until then. */
+	if (other->type == DRM_PLANE_TYPE_OVERLAY && other->fb && swc.active
+	    && (plane->need_modeset || test_plane(plane, other) < 0))
+		return false;
+
+	if (wl_list_empty(&other->commit_link))
+		wl_list_insert(plane->dirty_planes.prev, &other->commit_link);
+	schedule_commit(plane);
+
+	return true;
+}
+
+void
+primary_plane_set_damage(struct primary_plane *plane, pixman_region32_t *damage)
+{
+	struct drm_mode_rect *rects;
+	pixman_box32_t *boxes;
+	int i, num_boxes;
+
+	plane->damage.size = 0;
+	boxes = pixman_region32_rectangles(damage, &num_boxes);
+	/* Past a point, a single rectangle is cheaper for drivers to handle. */
+	if (num_boxes > MAX_DAMAGE_RECTS) {
+		boxes = pixman_region32_extents(damage);
+		num_boxes = 1;
+	}
+	if (!(rects = wl_array_add(&plane->damage, num_boxes * sizeof(rects[0])))) {
+		plane->damage.size = 0;
+		return;
+	}
+	for (i = 0; i < num_boxes; ++i) {
+		rects[i].x1 = boxes[i].x1;
+		rects[i].y1 = boxes[i].y1;
+		rects[i].x2 = boxes[i].x2;
+		rects[i].y2 = boxes[i].y2;
+	}
+}
+
+bool
+primary_plane_set_vrr(struct primary_plane *plane, bool enable)
+{
+	if (!plane->vrr_prop)
+		return !enable;
+	if (plane->vrr != enable) {
+		plane->vrr = enable;
+		plane->vrr_pending = true;
+		schedule_commit(plane);
+	}
+
+	return true;
+}
+
+static uint64_t
+vblank_period(struct primary_plane *plane)
+{
+	/* Refresh is in mHz. */
+	return 1000000000000ull / plane->mode.refresh;
+}
+
+static uint64_t
+monotonic_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+handle_vblank_timer(void *data)
+{
+	struct primary_plane *plane = data;
+	struct screen *screen = wl_container_of(plane, screen, planes.primary);
+	uint64_t period = vblank_period(plane), frames;
+	struct frame_info info = {
+		.refresh = period,
+		.flags = WP_PRESENTATION_FEEDBACK_KIND_VSYNC,
+		.screen = screen,
+	};
+
+	frames = (monotonic_time() - plane->vblank_time) / period;
+	plane->vblank_time += MAX(frames, 1) * period;
+	plane->vblank_sequence += MAX(frames, 1);
+	info.time.tv_sec = plane->vblank_time / 1000000000;
+	info.time.tv_nsec = plane->vblank_time % 1000000000;
+	info.sequence = plane->vblank_sequence;
+	view_frame(&plane->view, &info);
+
+	return 0;
+}
+
+static void
+dirty_fb(struct primary_plane *plane, uint32_t fb)
+{
+	struct drm_mode_rect *rects = plane->damage.data;
+	drmModeClip clips[MAX_DAMAGE_RECTS];
+	size_t i, num_rects = plane->damage.size / sizeof(rects[0]);
+	int ret;
+
+	for (i = 0; i < num_rects; ++i) {
+		clips[i].x1 = rects[i].x1;
+		clips[i].y1 = rects[i].y1;
+		clips[i].x2 = rects[i].x2;
+		clips[i].y2 = rects[i].y2;
+	}
+	ret = drmModeDirtyFB(swc.drm->fd, fb, clips, num_rects);
+	if (ret == -ENOSYS)
+		swc.drm->dirty_fb = false;
+	else if (ret < 0)
+		DEBUG("Failed to mark framebuffer %u dirty: %s\n", fb, strerror(-ret));
 }
 
 static int
 attach(struct view *view, struct wld_buffer *buffer)
 {
 	struct primary_plane *plane = wl_container_of(view, plane, view);
+	uint64_t period, next;
 	uint32_t fb;
 	int ret;
 
+	if (plane->vblank_timer) {
+		/* The buffer is "displayed" at the next vertical blank. */
+		period = vblank_period(plane);
+		next = period - (monotonic_time() - plane->vblank_time) % period;
+		wl_event_source_timer_update(plane->vblank_timer, (next + 999999) / 1000000);
+		plane->damage.size = 0;
+		return 0;
+	}
+
 	fb = drm_get_framebuffer(buffer);
+	if (plane->plane) {
+		plane->fb = fb;
+		plane->fb_pending = true;
+		if (!plane->committing)
+			return commit(plane);
+
+		/* The framebuffer is committed once the commit in progress
+		 * completes, so make sure now that it would be accepted. */
+		plane->plane->fb = fb;
+		plane->plane->view.geometry = plane->view.geometry;
+		if (!plane->need_modeset && (ret = test_plane(plane, plane->plane)) < 0) {
+			plane->fb_pending = false;
+			plane->damage.size = 0;
+			return ret;
+		}
+		return 0;
+	}
+
 	if (plane->need_modeset) {
 		ret = drmModeSetCrtc(swc.drm->fd, plane->crtc, fb, 0, 0, plane->connectors.data, plane->connectors.size / 4, &plane->mode.info);
 
@@ -64,16 +404,31 @@ attach(struct view *view, struct wld_buffer *buffer)
 			plane->need_modeset = false;
 		} else {
 			ERROR("Could not set CRTC to next framebuffer: %s\n", strerror(-ret));
+			plane->damage.size = 0;
 			return ret;
 		}
 	} else {
-		ret = drmModePageFlip(swc.drm->fd, plane->crtc, fb, DRM_MODE_PAGE_FLIP_EVENT, &plane->drm_handler);
+		uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+
+		if (plane->async && swc.drm->async_flip)
+			flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+		ret = drmModePageFlip(swc.drm->fd, plane->crtc, fb, flags, &plane->drm_handler);
+		if (ret < 0 && flags & DRM_MODE_PAGE_FLIP_ASYNC) {
+			DEBUG("Asynchronous page flip failed, falling back to vsync\n");
+			flags &= ~DRM_MODE_PAGE_FLIP_ASYNC;
+			ret = drmModePageFlip(swc.drm->fd, plane->crtc, fb, flags, &plane->drm_handler);
+		}
 
 		if (ret < 0) {
 			ERROR("Page flip failed: %s\n", strerror(errno));
+			plane->damage.size = 0;
 			return ret;
 		}
+		plane->flipped_async = flags & DRM_MODE_PAGE_FLIP_ASYNC;
+		if (plane->damage.size > 0 && swc.drm->dirty_fb)
+			dirty_fb(plane, fb);
 	}
+	plane->damage.size = 0;
 
 	return 0;
 }
@@ -92,10 +447,32 @@ static const struct view_impl view_impl = {
 };
 
 static void
-handle_page_flip(struct drm_handler *handler, uint32_t time)
+handle_page_flip(struct drm_handler *handler, const struct timespec *time, uint32_t sequence)
 {
 	struct primary_plane *plane = wl_container_of(handler, plane, drm_handler);
-	view_frame(&plane->view, time);
+	struct screen *screen = wl_container_of(plane, screen, planes.primary);
+	bool frame = !plane->plane || plane->committed_fb;
+	struct frame_info info = {
+		.time = *time,
+		.refresh = plane->mode.refresh ? 1000000000000ull / plane->mode.refresh : 0,
+		.sequence = sequence,
+		.flags = WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK | WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION,
+		.screen = screen,
+	};
+
+	if (!plane->flipped_async)
+		info.flags |= WP_PRESENTATION_FEEDBACK_KIND_VSYNC;
+
+	plane->committing = false;
+	plane->committed_fb = false;
+
+	/* Only commits carrying a framebuffer from the compositor complete its
+	 * frames; others just updated the cursor or overlay planes. */
+	if (frame)
+		view_frame(&plane->view, &info);
+
+	if (plane->plane && (plane->fb_pending || plane->vrr_pending || !wl_list_empty(&plane->dirty_planes)))
+		commit_deferred(plane);
 }
 
 static void
@@ -112,11 +489,35 @@ handle_swc_event(struct wl_listener *listener, void *data)
 }
 
 bool
-primary_plane_initialize(struct primary_plane *plane, uint32_t crtc, struct mode *mode, uint32_t *connectors, uint32_t num_connectors)
+primary_plane_initialize(struct primary_plane *plane, uint32_t crtc, struct plane *drm_plane, struct mode *mode, uint32_t *connectors, uint32_t num_connectors)
 {
+	static const char *const crtc_property_names[] = {
+		[CRTC_MODE_ID] = "MODE_ID",
+		[CRTC_ACTIVE]  = "ACTIVE",
+	};
+	static const char *const vrr_property_names[] = { "VRR_ENABLED" };
 	uint32_t *plane_connectors;
+	uint64_t vrr_capable;
+	uint32_t i;
 
-	if (!(plane->original_crtc_state = drmModeGetCrtc(swc.drm->fd, crtc))) {
+	plane->plane = NULL;
+	if (drm_plane) {
+		if (swc.drm->atomic && drm_get_property_ids(crtc, DRM_MODE_OBJECT_CRTC, crtc_property_names, plane->crtc_props, CRTC_NUM_PROPERTIES))
+			plane->plane = drm_plane;
+		else
+			plane_destroy(drm_plane);
+	}
+
+	plane->original_crtc_state = NULL;
+	plane->vblank_timer = NULL;
+	if (swc.headless) {
+		if (!(plane->vblank_timer = wl_event_loop_add_timer(swc.event_loop, &handle_vblank_timer, plane))) {
+			ERROR("Failed to create vblank timer\n");
+			goto error0;
+		}
+		plane->vblank_time = monotonic_time();
+		plane->vblank_sequence = 0;
+	} else if (!(plane->original_crtc_state = drmModeGetCrtc(swc.drm->fd, crtc))) {
 		ERROR("Failed to get CRTC state for CRTC %u: %s\n", crtc, strerror(errno));
 		goto error0;
 	}
@@ -130,6 +531,19 @@ primary_plane_initialize(struct primary_plane *plane, uint32_t crtc, struct mode
 	}
 
 	memcpy(plane_connectors, connectors, num_connectors * sizeof(connectors[0]));
+
+	/* Adaptive sync is only set through atomic commits. */
+	plane->vrr_prop = 0;
+	if (plane->plane && drm_get_property_ids(crtc, DRM_MODE_OBJECT_CRTC, vrr_property_names, &plane->vrr_prop, 1)) {
+		for (i = 0; i < num_connectors; ++i) {
+			if (!drm_get_property_value(connectors[i], DRM_MODE_OBJECT_CONNECTOR, "vrr_capable", &vrr_capable) || !vrr_capable) {
+				plane->vrr_prop = 0;
+				break;
+			}
+		}
+	}
+	plane->vrr = false;
+	plane->vrr_pending = false;
 	plane->crtc = crtc;
 	plane->need_modeset = true;
 	view_initialize(&plane->view, &view_impl);
@@ -138,20 +552,47 @@ primary_plane_initialize(struct primary_plane *plane, uint32_t crtc, struct mode
 	plane->drm_handler.page_flip = &handle_page_flip;
 	plane->swc_listener.notify = &handle_swc_event;
 	plane->mode = *mode;
+	plane->fb = 0;
+	plane->fb_pending = false;
+	plane->async = false;
+	plane->flipped_async = false;
+	wl_array_init(&plane->damage);
+	plane->committing = false;
+	plane->committed_fb = false;
+	plane->discarded = false;
+	plane->commit_idle = NULL;
+	wl_list_init(&plane->dirty_planes);
 	wl_signal_add(&swc.event_signal, &plane->swc_listener);
 
 	return true;
 
 error1:
-	drmModeFreeCrtc(plane->original_crtc_state);
+	if (plane->vblank_timer)
+		wl_event_source_remove(plane->vblank_timer);
+	else
+		drmModeFreeCrtc(plane->original_crtc_state);
 error0:
+	if (plane->plane)
+		plane_destroy(plane->plane);
 	return false;
 }
 
 void
 primary_plane_finalize(struct primary_plane *plane)
 {
+	if (plane->commit_idle)
+		wl_event_source_remove(plane->commit_idle);
+	if (plane->plane)
+		plane_destroy(plane->plane);
+	if (plane->vrr)
+		drmModeObjectSetProperty(swc.drm->fd, plane->crtc, DRM_MODE_OBJECT_CRTC, plane->vrr_prop, 0);
+
 	wl_array_release(&plane->connectors);
+	wl_array_release(&plane->damage);
+	if (plane->vblank_timer) {
+		wl_event_source_remove(plane->vblank_timer);
+		return;
+	}
 	drmModeCrtcPtr crtc = plane->original_crtc_state;
 	drmModeSetCrtc(swc.drm->fd, crtc->crtc_id, crtc->buffer_id, crtc->x, crtc->y, NULL, 0, &crtc->mode);
 	drmModeFreeCrtc(crtc);
@@ -28,10 +28,19 @@
 #include "mode.h"
 #include "view.h"
 
+#include <pixman.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <wayland-server.h>
 
+struct plane;
+
+enum crtc_property {
+	CRTC_MODE_ID,
+	CRTC_ACTIVE,
+	CRTC_NUM_PROPERTIES,
+};
+
 struct primary_plane {
 	uint32_t crtc;
 	drmModeCrtcPtr original_crtc_state;
@@ -41,9 +50,74 @@ struct primary_plane {
 	bool need_modeset;
 	struct drm_handler drm_handler;
 	struct wl_listener swc_listener;
+
+	/* The DRM plane scanning out the CRTC, or NULL if atomic modesetting is
+	 * not used. */
+	struct plane *plane;
+	uint32_t crtc_props[CRTC_NUM_PROPERTIES];
+
+	/* Framebuffer to be scanned out on the next commit, if fb_pending. */
+	uint32_t fb;
+	bool fb_pending;
+
+	/* Whether the next framebuffer may be flipped without waiting for the
+	 * vertical blank, and whether the last one was. */
+	bool async, flipped_async;
+
+	/* Damage of the next framebuffer as an array of struct drm_mode_rect,
+	 * or empty if all of it is to be updated. */
+	struct wl_array damage;
+
+	/* The CRTC's VRR_ENABLED property, or 0 if the CRTC or any of its
+	 * connectors is not capable of adaptive sync. */
+	uint32_t vrr_prop;
+	/* Whether adaptive sync is enabled, and whether that has yet to be
+	 * committed. */
+	bool vrr, vrr_pending;
+
+	/* Planes with state changes for the next commit. */
+	struct wl_list dirty_planes;
+
+	/* Whether a commit is waiting for its page flip event, and whether it
+	 * carried a new framebuffer for the primary plane. */
+	bool committing, committed_fb;
+	struct wl_event_source *commit_idle;
+
+	/* Whether the frame about to complete is that of a framebuffer which
+	 * could not be committed, so the previous one is still scanned out. */
+	bool discarded;
+
+	/* Timer standing in for the vertical blank of a headless screen, and
+	 * the time in nanoseconds and sequence number of its last expiration. */
+	struct wl_event_source *vblank_timer;
+	uint64_t vblank_time, vblank_sequence;
 };
 
-bool primary_plane_initialize(struct primary_plane *plane, uint32_t crtc, struct mode *mode, uint32_t *connectors, uint32_t num_connectors);
+bool primary_plane_initialize(struct primary_plane *plane, uint32_t crtc, struct plane *drm_plane, struct mode *mode, uint32_t *connectors, uint32_t num_connectors);
 void primary_plane_finalize(struct primary_plane *plane);
 
+/**
+ * Queues the plane's current state for the next atomic commit on the CRTC.
+ *
+ * Overlay planes with a framebuffer are validated with a test commit first.
+ *
+ * @return Whether or not the plane state can be committed.
+ */
+bool primary_plane_update_plane(struct primary_plane *plane, struct plane *other);
+
+/**
+ * Sets the region of the next attached framebuffer that differs from what was
+ * last scanned out, in plane coordinates.
+ *
+ * Drivers that upload or compress framebuffers may then skip the rest of it.
+ */
+void primary_plane_set_damage(struct primary_plane *plane, pixman_region32_t *damage);
+
+/**
+ * Enables or disables adaptive sync on the CRTC with the next commit.
+ *
+ * @return Whether or not the CRTC supports the requested setting.
+ */
+bool primary_plane_set_vrr(struct primary_plane *plane, bool enable);
+
 #endif
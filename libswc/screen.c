@@ -24,6 +24,7 @@
 #include "screen.h"
 #include "drm.h"
 #include "event.h"
+#include "headless.h"
 #include "internal.h"
 #include "mode.h"
 #include "output.h"
@@ -54,13 +55,25 @@ swc_screen_set_handler(struct swc_screen *base, const struct swc_screen_handler
 	screen->handler_data = data;
 }
 
+EXPORT bool
+swc_screen_set_adaptive_sync(struct swc_screen *base, bool enable)
+{
+	struct screen *screen = INTERNAL(base);
+
+	return primary_plane_set_vrr(&screen->planes.primary, enable);
+}
+
 bool
 screens_initialize(void)
 {
 	wl_list_init(&swc.screens);
 
-	if (!drm_create_screens(&swc.screens))
+	if (swc.headless) {
+		if (!headless_create_screens(&swc.screens))
+			return false;
+	} else if (!drm_create_screens(&swc.screens)) {
 		return false;
+	}
 
 	if (wl_list_empty(&swc.screens))
 		return false;
@@ -98,7 +111,7 @@ bind_screen(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 }
 
 struct screen *
-screen_new(uint32_t crtc, struct output *output, struct plane *cursor_plane)
+screen_new(uint32_t crtc, struct output *output, struct plane *primary_plane, struct plane *cursor_plane)
 {
 	struct screen *screen;
 	int32_t x = 0;
@@ -119,13 +132,17 @@ screen_new(uint32_t crtc, struct output *output, struct plane *cursor_plane)
 
 	screen->crtc = crtc;
 
-	if (!primary_plane_initialize(&screen->planes.primary, crtc, output->preferred_mode, &output->connector, 1)) {
+	if (!primary_plane_initialize(&screen->planes.primary, crtc, primary_plane, output->preferred_mode, &output->connector, 1)) {
 		ERROR("Failed to initialize primary plane\n");
 		goto error2;
 	}
+	if (screen->planes.primary.plane)
+		screen->planes.primary.plane->screen = screen;
 
-	cursor_plane->screen = screen;
+	if (cursor_plane)
+		cursor_plane->screen = screen;
 	screen->planes.cursor = cursor_plane;
+	wl_list_init(&screen->planes.overlays);
 
 	screen->handler = &null_handler;
 	wl_signal_init(&screen->destroy_signal);
@@ -154,6 +171,7 @@ void
 screen_destroy(struct screen *screen)
 {
 	struct output *output, *next;
+	struct plane *plane, *next_plane;
 
 	if (active_screen == screen)
 		active_screen = NULL;
@@ -163,7 +181,10 @@ screen_destroy(struct screen *screen)
 	wl_list_for_each_safe (output, next, &screen->outputs, link)
 		output_destroy(output);
 	primary_plane_finalize(&screen->planes.primary);
-	plane_destroy(screen->planes.cursor);
+	if (screen->planes.cursor)
+		plane_destroy(screen->planes.cursor);
+	wl_list_for_each_safe (plane, next_plane, &screen->planes.overlays, link)
+		plane_destroy(plane);
 	free(screen);
 }
 
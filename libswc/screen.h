@@ -53,7 +53,10 @@ struct screen {
 
 	struct {
 		struct primary_plane primary;
+		/* NULL if the screen has no cursor plane. */
 		struct plane *cursor;
+		/* Overlay planes available for displaying views directly. */
+		struct wl_list overlays;
 	} planes;
 
 	struct wl_global *global;
@@ -67,7 +70,7 @@ struct screen {
 bool screens_initialize(void);
 void screens_finalize(void);
 
-struct screen *screen_new(uint32_t crtc, struct output *output, struct plane *cursor_plane);
+struct screen *screen_new(uint32_t crtc, struct output *output, struct plane *primary_plane, struct plane *cursor_plane);
 void screen_destroy(struct screen *screen);
 
 static inline uint32_t
@@ -28,17 +28,29 @@
  */
 
 #include "shm.h"
+#include "drm.h"
 #include "internal.h"
 #include "util.h"
 #include "wayland_buffer.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wayland-server.h>
+#include <wld/drm.h>
 #include <wld/pixman.h>
 #include <wld/wld.h>
+#ifdef __linux__
+#include <linux/udmabuf.h>
+#endif
+
+enum {
+	WLD_USER_OBJECT_POOL_REFERENCE = WLD_USER_ID + 2
+};
 
 struct pool {
 	struct wl_resource *resource;
@@ -46,11 +58,20 @@ struct pool {
 	void *data;
 	uint32_t size;
 	unsigned references;
+	/* The pool's memfd if its memory can be shared with the GPU through
+	 * udmabuf, or -1. */
+	int fd;
 };
 
 struct pool_reference {
 	struct wld_destructor destructor;
 	struct pool *pool;
+
+	/* Only set up for pools that can be shared with the GPU. */
+	struct wld_exporter exporter;
+	uint32_t offset;
+	struct wld_buffer *drm_buffer;
+	bool imported;
 };
 
 static void *
@@ -70,6 +91,8 @@ unref_pool(struct pool *pool)
 		return;
 
 	munmap(pool->data, pool->size);
+	if (pool->fd != -1)
+		close(pool->fd);
 	free(pool);
 }
 
@@ -84,7 +107,100 @@ static void
 handle_buffer_destroy(struct wld_destructor *destructor)
 {
 	struct pool_reference *reference = wl_container_of(destructor, reference, destructor);
+	if (reference->drm_buffer)
+		wld_buffer_unreference(reference->drm_buffer);
 	unref_pool(reference->pool);
+	free(reference);
+}
+
+static bool
+reference_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
+{
+	struct pool_reference *reference = wl_container_of(exporter, reference, exporter);
+
+	switch (type) {
+	case WLD_USER_OBJECT_POOL_REFERENCE:
+		object->ptr = reference;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Wraps the pages of a buffer's memory in a udmabuf and imports it into the
+ * DRM context.
+ */
+static struct wld_buffer *
+import_udmabuf(struct pool *pool, struct wld_buffer *buffer, uint32_t offset)
+{
+#ifdef UDMABUF_CREATE
+	struct udmabuf_create create = {
+		.memfd = pool->fd,
+		.flags = UDMABUF_FLAGS_CLOEXEC,
+		.offset = offset,
+	};
+	struct wld_buffer *drm_buffer;
+	union wld_object object;
+	struct stat st;
+	long page_size = sysconf(_SC_PAGESIZE);
+	int fd;
+
+	/* Only whole pages can be shared. */
+	if (page_size <= 0 || offset % page_size != 0)
+		return NULL;
+	create.size = ((uint64_t)buffer->pitch * buffer->height + page_size - 1) / page_size * page_size;
+	if (fstat(pool->fd, &st) < 0 || create.offset + create.size > (uint64_t)st.st_size)
+		return NULL;
+	if ((fd = ioctl(pool->shm->udmabuf, UDMABUF_CREATE, &create)) < 0) {
+		DEBUG("Could not create udmabuf: %s\n", strerror(errno));
+		return NULL;
+	}
+	object.i = fd;
+	drm_buffer = wld_import_buffer(swc.drm->context, WLD_DRM_OBJECT_PRIME_FD, object, buffer->width, buffer->height, buffer->format, buffer->pitch);
+	close(fd);
+
+	return drm_buffer;
+#else
+	return NULL;
+#endif
+}
+
+struct wld_buffer *
+shm_get_drm_buffer(struct wld_buffer *buffer)
+{
+	struct pool_reference *reference;
+	union wld_object object;
+
+	if (!buffer || !wld_export(buffer, WLD_USER_OBJECT_POOL_REFERENCE, &object))
+		return NULL;
+	reference = object.ptr;
+	if (!reference->imported) {
+		reference->drm_buffer = import_udmabuf(reference->pool, buffer, reference->offset);
+		reference->imported = true;
+	}
+
+	return reference->drm_buffer;
+}
+
+/**
+ * Returns whether the memfd can back a udmabuf, which requires that it can't
+ * shrink under the GPU but can still be written by the client.
+ */
+static bool
+can_share(struct swc_shm *shm, int fd)
+{
+#ifdef F_GET_SEALS
+	int seals;
+
+	if (shm->udmabuf == -1 || (seals = fcntl(fd, F_GET_SEALS)) == -1)
+		return false;
+	return seals & F_SEAL_SHRINK && !(seals & F_SEAL_WRITE);
+#else
+	return false;
+#endif
 }
 
 static inline uint32_t
@@ -132,6 +248,13 @@ create_buffer(struct wl_client *client, struct wl_resource *resource,
 	reference->pool = pool;
 	reference->destructor.destroy = &handle_buffer_destroy;
 	wld_buffer_add_destructor(buffer, &reference->destructor);
+	reference->offset = offset;
+	reference->drm_buffer = NULL;
+	reference->imported = false;
+	if (pool->fd != -1) {
+		reference->exporter.export = &reference_export;
+		wld_buffer_add_exporter(buffer, &reference->exporter);
+	}
 	++pool->references;
 
 	return;
@@ -177,6 +300,7 @@ create_pool(struct wl_client *client, struct wl_resource *resource, uint32_t id,
 		goto error0;
 	}
 	pool->shm = shm;
+	pool->fd = -1;
 	pool->resource = wl_resource_create(client, &wl_shm_pool_interface, wl_resource_get_version(resource), id);
 	if (!pool->resource) {
 		wl_resource_post_no_memory(resource);
@@ -188,7 +312,10 @@ create_pool(struct wl_client *client, struct wl_resource *resource, uint32_t id,
 		wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FD, "mmap failed: %s", strerror(errno));
 		goto error2;
 	}
-	close(fd);
+	if (can_share(shm, fd))
+		pool->fd = fd;
+	else
+		close(fd);
 	pool->size = size;
 	pool->references = 1;
 	return;
@@ -240,6 +367,17 @@ shm_create(struct wl_display *display)
 	if (!shm->global)
 		goto error3;
 
+	/* With a GPU, shm pools are imported as udmabufs where possible so that
+	 * they can be read without a copy. */
+	shm->udmabuf = -1;
+#ifdef UDMABUF_CREATE
+	if (!swc.headless && !wld_drm_is_dumb(swc.drm->context)) {
+		shm->udmabuf = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+		if (shm->udmabuf == -1)
+			DEBUG("Could not open /dev/udmabuf: %s\n", strerror(errno));
+	}
+#endif
+
 	return shm;
 
 error3:
@@ -256,6 +394,8 @@ void
 shm_destroy(struct swc_shm *shm)
 {
 	wl_global_destroy(shm->global);
+	if (shm->udmabuf != -1)
+		close(shm->udmabuf);
 	wld_destroy_renderer(shm->renderer);
 	wld_destroy_context(shm->context);
 	free(shm);
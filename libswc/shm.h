@@ -25,14 +25,23 @@
 #define SWC_SHM_H
 
 struct wl_display;
+struct wld_buffer;
 
 struct swc_shm {
 	struct wl_global *global;
 	struct wld_context *context;
 	struct wld_renderer *renderer;
+	/* /dev/udmabuf, or -1 if shm buffers are not shared with the GPU. */
+	int udmabuf;
 };
 
 struct swc_shm *shm_create(struct wl_display *display);
 void shm_destroy(struct swc_shm *shm);
 
+/**
+ * Returns a buffer in the DRM context sharing the memory of an shm buffer, or
+ * NULL if the buffer's pool can't be shared with the GPU.
+ */
+struct wld_buffer *shm_get_drm_buffer(struct wld_buffer *buffer);
+
 #endif
@@ -0,0 +1,137 @@
+/* swc: libswc/single_pixel_buffer.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "single_pixel_buffer.h"
+#include "internal.h"
+#include "shm.h"
+#include "util.h"
+#include "wayland_buffer.h"
+
+#include <stdlib.h>
+#include <wayland-server.h>
+#include <wld/wld.h>
+#include "single-pixel-buffer-v1-server-protocol.h"
+
+enum {
+	WLD_USER_OBJECT_SOLID_COLOR = WLD_USER_ID + 3
+};
+
+struct single_pixel_buffer {
+	struct wld_exporter exporter;
+	struct wld_destructor destructor;
+	uint32_t pixel;
+};
+
+static bool
+solid_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
+{
+	struct single_pixel_buffer *solid = wl_container_of(exporter, solid, exporter);
+
+	switch (type) {
+	case WLD_USER_OBJECT_SOLID_COLOR:
+		object->u32 = solid->pixel;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void
+solid_destroy(struct wld_destructor *destructor)
+{
+	struct single_pixel_buffer *solid = wl_container_of(destructor, solid, destructor);
+	free(solid);
+}
+
+bool
+single_pixel_buffer_get_color(struct wld_buffer *buffer, uint32_t *color)
+{
+	union wld_object object;
+
+	if (!wld_export(buffer, WLD_USER_OBJECT_SOLID_COLOR, &object))
+		return false;
+	*color = object.u32;
+	return true;
+}
+
+static void
+create_u32_rgba_buffer(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                       uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+	struct single_pixel_buffer *solid;
+	struct wld_buffer *buffer;
+	union wld_object object;
+
+	if (!(solid = malloc(sizeof(*solid))))
+		goto error0;
+	/* The channels are already premultiplied, so only their precision needs
+	 * to be reduced. */
+	solid->pixel = (a >> 24) << 24 | (r >> 24) << 16 | (g >> 24) << 8 | b >> 24;
+	object.ptr = &solid->pixel;
+	buffer = wld_import_buffer(swc.shm->context, WLD_OBJECT_DATA, object, 1, 1, WLD_FORMAT_ARGB8888, sizeof(solid->pixel));
+	if (!buffer)
+		goto error1;
+	solid->exporter.export = &solid_export;
+	wld_buffer_add_exporter(buffer, &solid->exporter);
+	solid->destructor.destroy = &solid_destroy;
+	wld_buffer_add_destructor(buffer, &solid->destructor);
+
+	/* The buffer now owns solid. */
+	if (!wayland_buffer_create_resource(client, 1, id, buffer))
+		goto error2;
+	return;
+
+error2:
+	wld_buffer_unreference(buffer);
+	goto error0;
+error1:
+	free(solid);
+error0:
+	wl_resource_post_no_memory(resource);
+}
+
+static const struct wp_single_pixel_buffer_manager_v1_interface single_pixel_buffer_manager_impl = {
+	.destroy = destroy_resource,
+	.create_u32_rgba_buffer = create_u32_rgba_buffer,
+};
+
+static void
+bind_single_pixel_buffer_manager(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+	struct wl_resource *resource;
+
+	resource = wl_resource_create(client, &wp_single_pixel_buffer_manager_v1_interface, version, id);
+	if (!resource) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &single_pixel_buffer_manager_impl, NULL, NULL);
+}
+
+struct wl_global *
+single_pixel_buffer_manager_create(struct wl_display *display)
+{
+	return wl_global_create(display, &wp_single_pixel_buffer_manager_v1_interface, 1, NULL, &bind_single_pixel_buffer_manager);
+}
@@ -0,0 +1,41 @@
+/* swc: libswc/single_pixel_buffer.h
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SWC_SINGLE_PIXEL_BUFFER_H
+#define SWC_SINGLE_PIXEL_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct wl_display;
+struct wld_buffer;
+
+struct wl_global *single_pixel_buffer_manager_create(struct wl_display *display);
+
+/**
+ * Returns whether the buffer is a single-pixel buffer, and if so, stores its
+ * premultiplied ARGB8888 color in color.
+ */
+bool single_pixel_buffer_get_color(struct wld_buffer *buffer, uint32_t *color);
+
+#endif
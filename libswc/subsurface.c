@@ -22,39 +22,222 @@
  */
 
 #include "subsurface.h"
+#include "compositor.h"
+#include "surface.h"
 #include "util.h"
 
 #include <stdlib.h>
 #include <wayland-server.h>
 
+static void
+update_position(struct subsurface *subsurface)
+{
+	const struct swc_rectangle *geom;
+
+	if (!subsurface->parent_view)
+		return;
+	geom = &subsurface->parent_view->base.geometry;
+	view_move(&subsurface->view->base, geom->x + subsurface->x, geom->y + subsurface->y);
+}
+
+static void
+handle_parent_view_move(struct view_handler *handler)
+{
+	struct subsurface *subsurface = wl_container_of(handler, subsurface, parent_view_handler);
+	update_position(subsurface);
+}
+
+static const struct view_handler_impl parent_view_handler_impl = {
+	.move = handle_parent_view_move,
+};
+
+static void
+unlink_parent_view(struct subsurface *subsurface)
+{
+	if (!subsurface->parent_view)
+		return;
+	wl_list_remove(&subsurface->parent_view_handler.link);
+	wl_list_remove(&subsurface->parent_view_destroy_listener.link);
+	subsurface->parent_view = NULL;
+	if (subsurface->view) {
+		subsurface->view->parent = NULL;
+		compositor_view_hide(subsurface->view);
+	}
+}
+
+static void
+handle_parent_view_destroy(struct wl_listener *listener, void *data)
+{
+	struct subsurface *subsurface = wl_container_of(listener, subsurface, parent_view_destroy_listener);
+	unlink_parent_view(subsurface);
+}
+
+/**
+ * Follows the view of the parent surface, which may be created or replaced
+ * after the subsurface, for example when the parent becomes a window.
+ *
+ * @return Whether or not the parent view changed.
+ */
+static bool
+update_parent_view(struct subsurface *subsurface)
+{
+	struct compositor_view *parent_view = subsurface->parent->view ? compositor_view(subsurface->parent->view) : NULL;
+
+	if (parent_view == subsurface->parent_view)
+		return false;
+
+	unlink_parent_view(subsurface);
+	if (parent_view) {
+		subsurface->parent_view = parent_view;
+		wl_list_insert(&parent_view->base.handlers, &subsurface->parent_view_handler.link);
+		wl_signal_add(&parent_view->destroy_signal, &subsurface->parent_view_destroy_listener);
+		compositor_view_set_parent(subsurface->view, parent_view);
+		update_position(subsurface);
+	}
+
+	return true;
+}
+
+static void
+add_view(struct wl_array *views, struct surface *surface)
+{
+	struct compositor_view *view, **entry;
+
+	if (surface->view && (view = compositor_view(surface->view)) && (entry = wl_array_add(views, sizeof(*entry))))
+		*entry = view;
+}
+
+/**
+ * Collects the views of the surface and its subsurfaces, from bottom to top.
+ */
+static void
+collect_views(struct wl_array *views, struct surface *surface)
+{
+	struct subsurface *subsurface;
+	bool added = false;
+
+	wl_list_for_each (subsurface, &surface->subsurfaces, link) {
+		if (!subsurface->below && !added) {
+			add_view(views, surface);
+			added = true;
+		}
+		collect_views(views, subsurface->surface);
+	}
+	if (!added)
+		add_view(views, surface);
+}
+
+/**
+ * Stacks the views of the surface's subsurfaces around its own view.
+ */
+static void
+restack(struct surface *surface)
+{
+	struct compositor_view *anchor, **views;
+	struct wl_array array;
+	size_t i, count, index;
+
+	if (!surface->view || !(anchor = compositor_view(surface->view)))
+		return;
+
+	wl_array_init(&array);
+	collect_views(&array, surface);
+	views = array.data;
+	count = array.size / sizeof(*views);
+	for (index = 0; index < count && views[index] != anchor; ++index)
+		;
+	if (index < count) {
+		for (i = index; i > 0; --i)
+			compositor_view_place_below(views[i - 1], views[i]);
+		for (i = index + 1; i < count; ++i)
+			compositor_view_place_above(views[i], views[i - 1]);
+	}
+	wl_array_release(&array);
+}
+
+/**
+ * Places the subsurface directly above or below its parent in the pending
+ * stacking order.
+ */
+static void
+place_at_parent(struct subsurface *subsurface, bool below)
+{
+	struct wl_list *link = subsurface->parent->pending_subsurfaces.prev;
+	struct subsurface *other;
+
+	wl_list_remove(&subsurface->pending_link);
+	wl_list_for_each (other, &subsurface->parent->pending_subsurfaces, pending_link) {
+		if (!other->pending_below) {
+			link = other->pending_link.prev;
+			break;
+		}
+	}
+	wl_list_insert(link, &subsurface->pending_link);
+	subsurface->pending_below = below;
+}
+
+static void
+place(struct wl_resource *resource, struct wl_resource *sibling_resource, bool above)
+{
+	struct subsurface *subsurface = wl_resource_get_user_data(resource), *sibling;
+	struct surface *surface = wl_resource_get_user_data(sibling_resource);
+
+	if (!subsurface->parent)
+		return;
+
+	if (surface == subsurface->parent) {
+		place_at_parent(subsurface, !above);
+	} else {
+		sibling = surface->subsurface;
+		if (!sibling || sibling == subsurface || sibling->parent != subsurface->parent) {
+			wl_resource_post_error(resource, WL_SUBSURFACE_ERROR_BAD_SURFACE, "surface is not a sibling or the parent");
+			return;
+		}
+		wl_list_remove(&subsurface->pending_link);
+		wl_list_insert(above ? &sibling->pending_link : sibling->pending_link.prev, &subsurface->pending_link);
+		subsurface->pending_below = sibling->pending_below;
+	}
+
+	subsurface->parent->subsurfaces_restacked = true;
+}
+
 static void
 set_position(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y)
 {
-	/* TODO: Implement. */
+	struct subsurface *subsurface = wl_resource_get_user_data(resource);
+
+	subsurface->pending.x = x;
+	subsurface->pending.y = y;
 }
 
 static void
 place_above(struct wl_client *client, struct wl_resource *resource, struct wl_resource *sibling_resource)
 {
-	/* TODO: Implement. */
+	place(resource, sibling_resource, true);
 }
 
 static void
 place_below(struct wl_client *client, struct wl_resource *resource, struct wl_resource *sibling_resource)
 {
-	/* TODO: Implement. */
+	place(resource, sibling_resource, false);
 }
 
 static void
 set_sync(struct wl_client *client, struct wl_resource *resource)
 {
-	/* TODO: Implement. */
+	struct subsurface *subsurface = wl_resource_get_user_data(resource);
+
+	subsurface->sync = true;
 }
 
 static void
 set_desync(struct wl_client *client, struct wl_resource *resource)
 {
-	/* TODO: Implement. */
+	struct subsurface *subsurface = wl_resource_get_user_data(resource);
+
+	/* State cached so far is applied with the next commit of either the
+	 * surface or its parent. */
+	subsurface->sync = false;
 }
 
 static const struct wl_subsurface_interface subsurface_impl = {
@@ -66,15 +249,95 @@ static const struct wl_subsurface_interface subsurface_impl = {
 	.set_desync = set_desync,
 };
 
+/**
+ * Removes the subsurface from its parent and unmaps it.
+ */
+static void
+detach(struct subsurface *subsurface)
+{
+	unlink_parent_view(subsurface);
+	if (subsurface->parent) {
+		wl_list_remove(&subsurface->link);
+		wl_list_remove(&subsurface->pending_link);
+		wl_list_remove(&subsurface->parent_destroy_listener.link);
+		subsurface->parent = NULL;
+	}
+	if (subsurface->view) {
+		compositor_view_destroy(subsurface->view);
+		subsurface->view = NULL;
+	}
+}
+
+static void
+handle_parent_destroy(struct wl_listener *listener, void *data)
+{
+	struct subsurface *subsurface = wl_container_of(listener, subsurface, parent_destroy_listener);
+	detach(subsurface);
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct subsurface *subsurface = wl_container_of(listener, subsurface, surface_destroy_listener);
+
+	detach(subsurface);
+	wl_list_remove(&subsurface->surface_destroy_listener.link);
+	subsurface->surface->subsurface = NULL;
+	subsurface->surface = NULL;
+}
+
 static void
 subsurface_destroy(struct wl_resource *resource)
 {
 	struct subsurface *subsurface = wl_resource_get_user_data(resource);
+
+	if (subsurface->surface)
+		handle_surface_destroy(&subsurface->surface_destroy_listener, NULL);
 	free(subsurface);
 }
 
+bool
+subsurface_is_synchronized(struct subsurface *subsurface)
+{
+	for (; subsurface && subsurface->parent; subsurface = subsurface->parent->subsurface) {
+		if (subsurface->sync)
+			return true;
+	}
+
+	return false;
+}
+
+void
+subsurface_parent_commit(struct surface *parent)
+{
+	struct subsurface *subsurface;
+	bool restacked = parent->subsurfaces_restacked;
+
+	if (restacked) {
+		wl_list_for_each (subsurface, &parent->pending_subsurfaces, pending_link) {
+			wl_list_remove(&subsurface->link);
+			wl_list_insert(parent->subsurfaces.prev, &subsurface->link);
+			subsurface->below = subsurface->pending_below;
+		}
+		parent->subsurfaces_restacked = false;
+	}
+
+	wl_list_for_each (subsurface, &parent->subsurfaces, link) {
+		restacked = update_parent_view(subsurface) || restacked;
+		if (subsurface->x != subsurface->pending.x || subsurface->y != subsurface->pending.y) {
+			subsurface->x = subsurface->pending.x;
+			subsurface->y = subsurface->pending.y;
+			update_position(subsurface);
+		}
+		surface_apply_cached(subsurface->surface);
+	}
+
+	if (restacked)
+		restack(parent);
+}
+
 struct subsurface *
-subsurface_new(struct wl_client *client, uint32_t version, uint32_t id)
+subsurface_new(struct wl_client *client, uint32_t version, uint32_t id, struct surface *surface, struct surface *parent)
 {
 	struct subsurface *subsurface;
 
@@ -86,10 +349,42 @@ subsurface_new(struct wl_client *client, uint32_t version, uint32_t id)
 	if (!subsurface->resource)
 		goto error1;
 
+	if (!(subsurface->view = compositor_create_view(surface)))
+		goto error2;
+
 	wl_resource_set_implementation(subsurface->resource, &subsurface_impl, subsurface, &subsurface_destroy);
 
+	subsurface->surface = surface;
+	subsurface->surface_destroy_listener.notify = &handle_surface_destroy;
+	wl_resource_add_destroy_listener(surface->resource, &subsurface->surface_destroy_listener);
+	surface->subsurface = subsurface;
+
+	subsurface->parent = parent;
+	subsurface->parent_destroy_listener.notify = &handle_parent_destroy;
+	wl_resource_add_destroy_listener(parent->resource, &subsurface->parent_destroy_listener);
+
+	subsurface->parent_view = NULL;
+	subsurface->parent_view_handler.impl = &parent_view_handler_impl;
+	subsurface->parent_view_destroy_listener.notify = &handle_parent_view_destroy;
+
+	subsurface->x = 0;
+	subsurface->y = 0;
+	subsurface->pending.x = 0;
+	subsurface->pending.y = 0;
+	subsurface->sync = true;
+
+	/* New subsurfaces are placed at the top of their parent's stack. */
+	subsurface->below = false;
+	subsurface->pending_below = false;
+	wl_list_insert(parent->subsurfaces.prev, &subsurface->link);
+	wl_list_insert(parent->pending_subsurfaces.prev, &subsurface->pending_link);
+	parent->subsurfaces_restacked = true;
+	update_parent_view(subsurface);
+
 	return subsurface;
 
+error2:
+	wl_resource_destroy(subsurface->resource);
 error1:
 	free(subsurface);
 error0:
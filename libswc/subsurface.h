@@ -24,14 +24,55 @@
 #ifndef SWC_SUBSURFACE_H
 #define SWC_SUBSURFACE_H
 
+#include "view.h"
+
+#include <stdbool.h>
 #include <stdint.h>
+#include <wayland-server.h>
 
-struct wl_client;
+struct compositor_view;
+struct surface;
 
 struct subsurface {
 	struct wl_resource *resource;
+	struct surface *surface, *parent;
+	struct wl_listener surface_destroy_listener, parent_destroy_listener;
+
+	/* The view displaying the surface, and the one of the parent it is
+	 * placed relative to. */
+	struct compositor_view *view, *parent_view;
+	struct view_handler parent_view_handler;
+	struct wl_listener parent_view_destroy_listener;
+
+	/* The position relative to the parent, and the one to be applied with
+	 * the parent's next commit. */
+	int32_t x, y;
+	struct {
+		int32_t x, y;
+	} pending;
+
+	/* Whether the surface's state is applied together with its parent's. */
+	bool sync;
+
+	/* The subsurface's entries in its parent's lists of subsurfaces, and
+	 * whether it is stacked below the parent in each of them. */
+	struct wl_list link, pending_link;
+	bool below, pending_below;
 };
 
-struct subsurface *subsurface_new(struct wl_client *client, uint32_t version, uint32_t id);
+struct subsurface *subsurface_new(struct wl_client *client, uint32_t version, uint32_t id, struct surface *surface, struct surface *parent);
+
+/**
+ * Returns whether the subsurface, or any subsurface it is a descendant of, is
+ * in synchronized mode.
+ */
+bool subsurface_is_synchronized(struct subsurface *subsurface);
+
+/**
+ * Applies the state of the surface's subsurfaces that depends on the surface's
+ * commit: their position, stacking order, and the cached state of those that
+ * are synchronized.
+ */
+void subsurface_parent_commit(struct surface *parent);
 
 #endif
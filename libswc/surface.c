@@ -22,17 +22,22 @@
  */
 
 #include "surface.h"
+#include "compositor.h"
+#include "dmabuf.h"
 #include "event.h"
 #include "internal.h"
 #include "output.h"
+#include "presentation.h"
 #include "region.h"
 #include "screen.h"
+#include "subsurface.h"
 #include "util.h"
 #include "view.h"
 #include "wayland_buffer.h"
 
 #include <stdlib.h>
 #include <wld/wld.h>
+#include "viewporter-server-protocol.h"
 
 /**
  * Removes a buffer from a surface state.
@@ -44,19 +49,31 @@ handle_buffer_destroy(struct wl_listener *listener, void *data)
 
 	state = wl_container_of(listener, state, buffer_destroy_listener);
 	state->buffer = NULL;
+	state->buffer_resource = NULL;
 }
 
 static void
 state_initialize(struct surface_state *state)
 {
 	state->buffer = NULL;
+	state->buffer_resource = NULL;
 	state->buffer_destroy_listener.notify = &handle_buffer_destroy;
+	state->buffer_released = false;
 
 	pixman_region32_init(&state->damage);
 	pixman_region32_init(&state->opaque);
 	pixman_region32_init_with_extents(&state->input, &infinite_extents);
 
 	wl_list_init(&state->frame_callbacks);
+	wl_list_init(&state->feedbacks);
+	state->tearing = false;
+
+	state->viewport.src_x = wl_fixed_from_int(-1);
+	state->viewport.src_y = wl_fixed_from_int(-1);
+	state->viewport.src_width = wl_fixed_from_int(-1);
+	state->viewport.src_height = wl_fixed_from_int(-1);
+	state->viewport.width = -1;
+	state->viewport.height = -1;
 }
 
 static void
@@ -74,6 +91,8 @@ state_finalize(struct surface_state *state)
 	/* Remove all leftover callbacks. */
 	wl_list_for_each_safe (resource, tmp, &state->frame_callbacks, link)
 		wl_resource_destroy(resource);
+
+	presentation_send_discarded(&state->feedbacks);
 }
 
 /**
@@ -93,13 +112,15 @@ state_set_buffer(struct surface_state *state, struct wl_resource *resource)
 
 	state->buffer = buffer;
 	state->buffer_resource = resource;
+	state->buffer_released = false;
 }
 
 static void
-handle_frame(struct view_handler *handler, uint32_t time)
+handle_frame(struct view_handler *handler, const struct frame_info *info)
 {
 	struct surface *surface = wl_container_of(handler, surface, view_handler);
 	struct wl_resource *resource, *tmp;
+	uint32_t time = frame_info_msec(info);
 
 	wl_list_for_each_safe (resource, tmp, &surface->state.frame_callbacks, link) {
 		wl_callback_send_done(resource, time);
@@ -107,6 +128,7 @@ handle_frame(struct view_handler *handler, uint32_t time)
 	}
 
 	wl_list_init(&surface->state.frame_callbacks);
+	presentation_send_presented(&surface->latched_feedbacks, info);
 }
 
 static void
@@ -211,57 +233,175 @@ set_input_region(struct wl_client *client, struct wl_resource *resource, struct
 }
 
 static inline void
-trim_region(pixman_region32_t *region, struct wld_buffer *buffer)
+trim_region(pixman_region32_t *region, uint32_t width, uint32_t height)
 {
-	pixman_region32_intersect_rect(region, region, 0, 0, buffer ? buffer->width : 0, buffer ? buffer->height : 0);
+	pixman_region32_intersect_rect(region, region, 0, 0, width, height);
 }
 
+/**
+ * Checks that the surface's viewport is consistent with its buffer, and posts
+ * an error otherwise.
+ */
+static bool
+check_viewport(struct surface *surface)
+{
+	struct surface_state *state = &surface->state;
+
+	if (!surface->viewport || !state->buffer)
+		return true;
+
+	if (state->viewport.width < 0 && state->viewport.src_width >= 0
+	    && (state->viewport.src_width & 0xff || state->viewport.src_height & 0xff)) {
+		wl_resource_post_error(surface->viewport, WP_VIEWPORT_ERROR_BAD_SIZE,
+		                       "source size is not integer and no destination size is set");
+		return false;
+	}
+	if (state->viewport.src_width >= 0
+	    && (state->viewport.src_x + state->viewport.src_width > wl_fixed_from_int(state->buffer->width)
+	        || state->viewport.src_y + state->viewport.src_height > wl_fixed_from_int(state->buffer->height))) {
+		wl_resource_post_error(surface->viewport, WP_VIEWPORT_ERROR_OUT_OF_BUFFER,
+		                       "source rectangle extends outside of the buffer");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Adds the pending state to the state to be applied.
+ */
 static void
-commit(struct wl_client *client, struct wl_resource *resource)
+cache_pending(struct surface_pending *cached, struct surface_pending *pending)
 {
-	struct surface *surface = wl_resource_get_user_data(resource);
+	if (pending->commit & SURFACE_COMMIT_ATTACH) {
+		state_set_buffer(&cached->state, pending->state.buffer_resource);
+		cached->x = pending->x;
+		cached->y = pending->y;
+	}
+
+	if (pending->commit & SURFACE_COMMIT_DAMAGE) {
+		pixman_region32_union(&cached->state.damage, &cached->state.damage, &pending->state.damage);
+		pixman_region32_clear(&pending->state.damage);
+	}
+
+	if (pending->commit & SURFACE_COMMIT_OPAQUE)
+		pixman_region32_copy(&cached->state.opaque, &pending->state.opaque);
+
+	if (pending->commit & SURFACE_COMMIT_INPUT)
+		pixman_region32_copy(&cached->state.input, &pending->state.input);
+
+	if (pending->commit & SURFACE_COMMIT_FRAME) {
+		wl_list_insert_list(cached->state.frame_callbacks.prev, &pending->state.frame_callbacks);
+		wl_list_init(&pending->state.frame_callbacks);
+	}
+
+	if (pending->commit & SURFACE_COMMIT_VIEWPORT)
+		cached->state.viewport = pending->state.viewport;
+
+	cached->state.tearing = pending->state.tearing;
+
+	/* Cached content that is replaced before it was applied is never
+	 * displayed. */
+	if (!wl_list_empty(&pending->state.feedbacks)) {
+		presentation_send_discarded(&cached->state.feedbacks);
+		wl_list_insert_list(&cached->state.feedbacks, &pending->state.feedbacks);
+		wl_list_init(&pending->state.feedbacks);
+	}
+
+	cached->commit |= pending->commit;
+	pending->commit = 0;
+}
+
+static void
+apply(struct surface *surface, struct surface_pending *pending)
+{
+	struct compositor_view *view;
 	struct wld_buffer *buffer;
+	wl_fixed_t x, y, src_width, src_height;
+	uint32_t width, height;
 
 	/* Attach */
-	if (surface->pending.commit & SURFACE_COMMIT_ATTACH) {
-		if (surface->state.buffer && surface->state.buffer != surface->pending.state.buffer)
-			wl_buffer_send_release(surface->state.buffer_resource);
-
-		state_set_buffer(&surface->state, surface->pending.state.buffer_resource);
+	if (pending->commit & SURFACE_COMMIT_ATTACH) {
+		/* A buffer that is still scanned out is released once it has
+		 * left the screen. */
+		if (surface->state.buffer && surface->state.buffer != pending->state.buffer && !surface->state.buffer_released)
+			wayland_buffer_release(surface->state.buffer_resource);
+
+		state_set_buffer(&surface->state, pending->state.buffer_resource);
+		if (surface->state.buffer)
+			wayland_buffer_cancel_release(surface->state.buffer_resource);
 	}
 
 	buffer = surface->state.buffer;
 
 	/* Damage */
-	if (surface->pending.commit & SURFACE_COMMIT_DAMAGE) {
-		pixman_region32_union(&surface->state.damage, &surface->state.damage, &surface->pending.state.damage);
-		pixman_region32_clear(&surface->pending.state.damage);
+	if (pending->commit & SURFACE_COMMIT_DAMAGE) {
+		pixman_region32_union(&surface->state.damage, &surface->state.damage, &pending->state.damage);
+		pixman_region32_clear(&pending->state.damage);
 	}
 
 	/* Opaque */
-	if (surface->pending.commit & SURFACE_COMMIT_OPAQUE)
-		pixman_region32_copy(&surface->state.opaque, &surface->pending.state.opaque);
+	if (pending->commit & SURFACE_COMMIT_OPAQUE) {
+		pixman_region32_copy(&surface->state.opaque, &pending->state.opaque);
+		if (surface->view && (view = compositor_view(surface->view)))
+			compositor_view_update_opaque(view);
+	}
 
 	/* Input */
-	if (surface->pending.commit & SURFACE_COMMIT_INPUT)
-		pixman_region32_copy(&surface->state.input, &surface->pending.state.input);
+	if (pending->commit & SURFACE_COMMIT_INPUT)
+		pixman_region32_copy(&surface->state.input, &pending->state.input);
 
 	/* Frame */
-	if (surface->pending.commit & SURFACE_COMMIT_FRAME) {
-		wl_list_insert_list(&surface->state.frame_callbacks, &surface->pending.state.frame_callbacks);
-		wl_list_init(&surface->pending.state.frame_callbacks);
+	if (pending->commit & SURFACE_COMMIT_FRAME) {
+		wl_list_insert_list(&surface->state.frame_callbacks, &pending->state.frame_callbacks);
+		wl_list_init(&pending->state.frame_callbacks);
 	}
 
-	trim_region(&surface->state.damage, buffer);
-	trim_region(&surface->state.opaque, buffer);
+	surface->state.tearing = pending->state.tearing;
+
+	/* Presentation feedback. Content that was never submitted for display is
+	 * superseded by this commit. */
+	presentation_send_discarded(&surface->state.feedbacks);
+	wl_list_insert_list(&surface->state.feedbacks, &pending->state.feedbacks);
+	wl_list_init(&pending->state.feedbacks);
+
+	/* Viewport */
+	if (pending->commit & SURFACE_COMMIT_VIEWPORT)
+		surface->state.viewport = pending->state.viewport;
+	if (!check_viewport(surface))
+		return;
+
+	/* Damage to a cropped or scaled buffer does not map exactly to the
+	 * surface, so all of it is repainted. */
+	surface_get_size(surface, &width, &height);
+	if ((pending->commit & SURFACE_COMMIT_VIEWPORT || pixman_region32_not_empty(&surface->state.damage))
+	    && surface_get_source(surface, &x, &y, &src_width, &src_height))
+		pixman_region32_union_rect(&surface->state.damage, &surface->state.damage, 0, 0, width, height);
+
+	trim_region(&surface->state.damage, width, height);
+	trim_region(&surface->state.opaque, width, height);
 
 	if (surface->view) {
-		if (surface->pending.commit & SURFACE_COMMIT_ATTACH)
+		if (pending->commit & (SURFACE_COMMIT_ATTACH | SURFACE_COMMIT_VIEWPORT))
 			view_attach(surface->view, buffer);
 		view_update(surface->view);
 	}
 
-	surface->pending.commit = 0;
+	pending->commit = 0;
+
+	subsurface_parent_commit(surface);
+}
+
+static void
+commit(struct wl_client *client, struct wl_resource *resource)
+{
+	struct surface *surface = wl_resource_get_user_data(resource);
+
+	/* The pending state goes through the cache, which also holds the state
+	 * of previous commits if the surface was synchronized until now. */
+	cache_pending(&surface->cached, &surface->pending);
+	if (!surface->subsurface || !subsurface_is_synchronized(surface->subsurface))
+		apply(surface, &surface->cached);
 }
 
 static void
@@ -306,6 +446,9 @@ surface_destroy(struct wl_resource *resource)
 
 	state_finalize(&surface->state);
 	state_finalize(&surface->pending.state);
+	state_finalize(&surface->cached.state);
+	presentation_send_discarded(&surface->latched_feedbacks);
+	dmabuf_detach_feedbacks(&surface->dmabuf_feedbacks);
 
 	if (surface->view)
 		wl_list_remove(&surface->view_handler.link);
@@ -336,11 +479,21 @@ surface_new(struct wl_client *client, uint32_t version, uint32_t id)
 
 	/* Initialize the surface. */
 	surface->pending.commit = 0;
+	surface->cached.commit = 0;
 	surface->view = NULL;
 	surface->view_handler.impl = &view_handler_impl;
+	surface->subsurface = NULL;
+	surface->viewport = NULL;
+	wl_list_init(&surface->subsurfaces);
+	wl_list_init(&surface->pending_subsurfaces);
+	surface->subsurfaces_restacked = false;
 
 	state_initialize(&surface->state);
 	state_initialize(&surface->pending.state);
+	state_initialize(&surface->cached.state);
+	wl_list_init(&surface->latched_feedbacks);
+	wl_list_init(&surface->dmabuf_feedbacks);
+	surface->scanout_plane = NULL;
 
 	return surface;
 
@@ -367,3 +520,72 @@ surface_set_view(struct surface *surface, struct view *view)
 		view_update(view);
 	}
 }
+
+void
+surface_latch_feedback(struct surface *surface)
+{
+	wl_list_insert_list(surface->latched_feedbacks.prev, &surface->state.feedbacks);
+	wl_list_init(&surface->state.feedbacks);
+}
+
+void
+surface_get_size(struct surface *surface, uint32_t *width, uint32_t *height)
+{
+	struct surface_state *state = &surface->state;
+
+	if (!state->buffer) {
+		*width = 0;
+		*height = 0;
+	} else if (state->viewport.width >= 0) {
+		*width = state->viewport.width;
+		*height = state->viewport.height;
+	} else if (state->viewport.src_width >= 0) {
+		*width = wl_fixed_to_int(state->viewport.src_width);
+		*height = wl_fixed_to_int(state->viewport.src_height);
+	} else {
+		*width = state->buffer->width;
+		*height = state->buffer->height;
+	}
+}
+
+bool
+surface_get_source(struct surface *surface, wl_fixed_t *x, wl_fixed_t *y, wl_fixed_t *width, wl_fixed_t *height)
+{
+	struct surface_state *state = &surface->state;
+	uint32_t surface_width, surface_height;
+
+	if (!state->buffer)
+		return false;
+
+	if (state->viewport.src_width >= 0) {
+		*x = state->viewport.src_x;
+		*y = state->viewport.src_y;
+		*width = state->viewport.src_width;
+		*height = state->viewport.src_height;
+	} else {
+		*x = 0;
+		*y = 0;
+		*width = wl_fixed_from_int(state->buffer->width);
+		*height = wl_fixed_from_int(state->buffer->height);
+	}
+	surface_get_size(surface, &surface_width, &surface_height);
+
+	return *x != 0 || *y != 0 || *width != wl_fixed_from_int(state->buffer->width) || *height != wl_fixed_from_int(state->buffer->height)
+	       || surface_width != state->buffer->width || surface_height != state->buffer->height;
+}
+
+void
+surface_apply_cached(struct surface *surface)
+{
+	if (surface->cached.commit || !wl_list_empty(&surface->cached.state.feedbacks))
+		apply(surface, &surface->cached);
+}
+
+void
+surface_release_buffer(struct surface *surface)
+{
+	if (!surface->state.buffer || surface->state.buffer_released)
+		return;
+	wayland_buffer_release(surface->state.buffer_resource);
+	surface->state.buffer_released = true;
+}
@@ -29,18 +29,25 @@
 #include <pixman.h>
 #include <wayland-server.h>
 
+struct plane;
+struct subsurface;
+
 enum {
 	SURFACE_COMMIT_ATTACH = (1 << 0),
 	SURFACE_COMMIT_DAMAGE = (1 << 1),
 	SURFACE_COMMIT_OPAQUE = (1 << 2),
 	SURFACE_COMMIT_INPUT = (1 << 3),
-	SURFACE_COMMIT_FRAME = (1 << 4)
+	SURFACE_COMMIT_FRAME = (1 << 4),
+	SURFACE_COMMIT_VIEWPORT = (1 << 5)
 };
 
 struct surface_state {
 	struct wld_buffer *buffer;
 	struct wl_resource *buffer_resource;
 	struct wl_listener buffer_destroy_listener;
+	/* Whether the buffer was released before being replaced, since its
+	 * content had already been copied. */
+	bool buffer_released;
 
 	/* The region that needs to be repainted. */
 	pixman_region32_t damage;
@@ -52,24 +59,96 @@ struct surface_state {
 	pixman_region32_t input;
 
 	struct wl_list frame_callbacks;
+
+	/* Presentation feedback resources for the state's content. */
+	struct wl_list feedbacks;
+
+	/* Whether the client prefers its content to be displayed as soon as
+	 * possible, even if it tears. */
+	bool tearing;
+
+	/* The part of the buffer shown in the surface, with a negative width if
+	 * it is the whole buffer, and the size it is scaled to, with a negative
+	 * width if it is not scaled. */
+	struct {
+		wl_fixed_t src_x, src_y, src_width, src_height;
+		int32_t width, height;
+	} viewport;
+};
+
+/* State set by the client that has not been applied yet. */
+struct surface_pending {
+	struct surface_state state;
+	uint32_t commit;
+	int32_t x, y;
 };
 
 struct surface {
 	struct wl_resource *resource;
 
 	struct surface_state state;
+	struct surface_pending pending;
 
-	struct {
-		struct surface_state state;
-		uint32_t commit;
-		int32_t x, y;
-	} pending;
+	/* State committed while the surface is a synchronized subsurface, which
+	 * is applied together with its parent's. */
+	struct surface_pending cached;
+
+	/* The subsurface role of the surface, or NULL. */
+	struct subsurface *subsurface;
+
+	/* The wp_viewport of the surface, or NULL. */
+	struct wl_resource *viewport;
+
+	/* The surface's subsurfaces from bottom to top, in their current
+	 * stacking order and in the one to be applied with the next commit. */
+	struct wl_list subsurfaces, pending_subsurfaces;
+	bool subsurfaces_restacked;
+
+	/* Presentation feedback for content that has been submitted for display,
+	 * waiting for the frame it appears in. */
+	struct wl_list latched_feedbacks;
+
+	/* The surface's linux-dmabuf feedback objects, and the plane its buffers
+	 * could be scanned out on, whose formats they are sent a tranche of. */
+	struct wl_list dmabuf_feedbacks;
+	struct plane *scanout_plane;
 
 	struct view *view;
 	struct view_handler view_handler;
 };
 
 struct surface *surface_new(struct wl_client *client, uint32_t version, uint32_t id);
+
+/**
+ * Gets the size of the surface, which is that of its buffer unless the buffer
+ * is cropped or scaled.
+ */
+void surface_get_size(struct surface *surface, uint32_t *width, uint32_t *height);
+
+/**
+ * Gets the part of the buffer shown in the surface, in buffer coordinates.
+ *
+ * @return Whether or not the buffer is cropped or scaled.
+ */
+bool surface_get_source(struct surface *surface, wl_fixed_t *x, wl_fixed_t *y, wl_fixed_t *width, wl_fixed_t *height);
+
+/**
+ * Applies the surface's cached state, if any.
+ */
+void surface_apply_cached(struct surface *surface);
+
 void surface_set_view(struct surface *surface, struct view *view);
 
+/**
+ * Marks the surface's current content as submitted for display, so that its
+ * presentation feedback is sent with the next frame.
+ */
+void surface_latch_feedback(struct surface *surface);
+
+/**
+ * Releases the surface's buffer back to the client once its content has been
+ * copied and its memory is no longer needed.
+ */
+void surface_release_buffer(struct surface *surface);
+
 #endif
@@ -29,19 +29,24 @@
 #include "data_device_manager.h"
 #include "drm.h"
 #include "event.h"
+#include "headless.h"
 #include "internal.h"
 #include "kde_decoration.h"
 #include "keyboard.h"
 #include "launch.h"
 #include "panel_manager.h"
 #include "pointer.h"
+#include "presentation.h"
 #include "screen.h"
 #include "screenshot.h"
 #include "seat.h"
 #include "shell.h"
 #include "shm.h"
+#include "single_pixel_buffer.h"
 #include "subcompositor.h"
+#include "tearing_control.h"
 #include "util.h"
+#include "viewporter.h"
 #include "window.h"
 #include "xdg_decoration.h"
 #include "xdg_shell.h"
@@ -49,6 +54,9 @@
 #include "xserver.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 extern struct swc_launch swc_launch;
 extern const struct swc_bindings swc_bindings;
 extern struct swc_compositor swc_compositor;
@@ -117,17 +125,27 @@ swc_initialize(struct wl_display *display, struct wl_event_loop *event_loop, con
 	swc.display = display;
 	swc.event_loop = event_loop ? event_loop : wl_display_get_event_loop(display);
 	swc.manager = manager;
-	const char *default_seat = "seat0";
+	const char *default_seat = "seat0", *backend;
 	wl_signal_init(&swc.event_signal);
 
-	if (!launch_initialize()) {
-		ERROR("Could not connect to swc-launch\n");
-		goto error0;
-	}
-
-	if (!drm_initialize()) {
-		ERROR("Could not initialize DRM\n");
-		goto error1;
+	backend = getenv("SWC_BACKEND");
+	swc.headless = backend && strcmp(backend, "headless") == 0;
+
+	if (swc.headless) {
+		if (!headless_initialize()) {
+			ERROR("Could not initialize headless backend\n");
+			goto error0;
+		}
+	} else {
+		if (!launch_initialize()) {
+			ERROR("Could not connect to swc-launch\n");
+			goto error0;
+		}
+
+		if (!drm_initialize()) {
+			ERROR("Could not initialize DRM\n");
+			goto error1;
+		}
 	}
 
 	swc.shm = shm_create(display);
@@ -211,6 +229,30 @@ swc_initialize(struct wl_display *display, struct wl_event_loop *event_loop, con
 		goto error13b;
 	}
 
+	swc.presentation = presentation_create(display);
+	if (!swc.presentation) {
+		ERROR("Could not initialize presentation\n");
+		goto error13c;
+	}
+
+	swc.tearing_control_manager = tearing_control_manager_create(display);
+	if (!swc.tearing_control_manager) {
+		ERROR("Could not initialize tearing control manager\n");
+		goto error13d;
+	}
+
+	swc.single_pixel_buffer_manager = single_pixel_buffer_manager_create(display);
+	if (!swc.single_pixel_buffer_manager) {
+		ERROR("Could not initialize single-pixel buffer manager\n");
+		goto error13e;
+	}
+
+	swc.viewporter = viewporter_create(display);
+	if (!swc.viewporter) {
+		ERROR("Could not initialize viewporter\n");
+		goto error13f;
+	}
+
 #ifdef ENABLE_XWAYLAND
 	if (!xserver_initialize()) {
 		ERROR("Could not initialize xwayland\n");
@@ -220,11 +262,23 @@ swc_initialize(struct wl_display *display, struct wl_event_loop *event_loop, con
 
 	setup_compositor();
 
+	/* Without swc-launch, there is no session to be activated by. */
+	if (swc.headless)
+		swc_activate();
+
 	return true;
 
 #ifdef ENABLE_XWAYLAND
 error14:
 #endif
+	wl_global_destroy(swc.viewporter);
+error13f:
+	wl_global_destroy(swc.single_pixel_buffer_manager);
+error13e:
+	wl_global_destroy(swc.tearing_control_manager);
+error13d:
+	wl_global_destroy(swc.presentation);
+error13c:
 	wl_global_destroy(swc.screenshot_manager);
 error13b:
 	wl_global_destroy(swc.background_manager);
@@ -253,6 +307,10 @@ error4:
 error3:
 	shm_destroy(swc.shm);
 error2:
+	if (swc.headless) {
+		headless_finalize();
+		goto error0;
+	}
 	drm_finalize();
 error1:
 	launch_finalize();
@@ -266,6 +324,10 @@ swc_finalize(void)
 #ifdef ENABLE_XWAYLAND
 	xserver_finalize();
 #endif
+	wl_global_destroy(swc.viewporter);
+	wl_global_destroy(swc.single_pixel_buffer_manager);
+	wl_global_destroy(swc.tearing_control_manager);
+	wl_global_destroy(swc.presentation);
 	wl_global_destroy(swc.screenshot_manager);
 	wl_global_destroy(swc.panel_manager);
 	wl_global_destroy(swc.xdg_decoration_manager);
@@ -277,6 +339,10 @@ swc_finalize(void)
 	screens_finalize();
 	bindings_finalize();
 	shm_destroy(swc.shm);
-	drm_finalize();
-	launch_finalize();
+	if (swc.headless) {
+		headless_finalize();
+	} else {
+		drm_finalize();
+		launch_finalize();
+	}
 }
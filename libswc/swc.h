@@ -91,6 +91,16 @@ struct swc_screen {
  */
 void swc_screen_set_handler(struct swc_screen *screen, const struct swc_screen_handler *handler, void *data);
 
+/**
+ * Enable or disable adaptive sync (variable refresh rate) on the screen.
+ *
+ * While enabled, a window scanned out directly is displayed as soon as its
+ * client commits a new frame rather than at the screen's fixed refresh rate.
+ *
+ * Returns whether or not the screen supports the requested setting.
+ */
+bool swc_screen_set_adaptive_sync(struct swc_screen *screen, bool enable);
+
 /* }}} */
 
 /* Windows {{{ */
@@ -238,6 +248,24 @@ void swc_window_set_geometry(struct swc_window *window, const struct swc_rectang
  */
 void swc_window_set_border(struct swc_window *window, uint32_t color, uint32_t width);
 
+enum {
+	/* Follow the client's tearing-control hint. */
+	SWC_TEARING_CLIENT,
+	/* Always wait for the vertical blank. */
+	SWC_TEARING_NEVER,
+	/* Display new content as soon as possible, even if it tears. */
+	SWC_TEARING_ALWAYS,
+};
+
+/**
+ * Set whether the window's content may be displayed with tearing.
+ *
+ * Tearing only happens while the window is scanned out directly, for example
+ * when it is fullscreen and opaque, and the driver supports asynchronous page
+ * flips.
+ */
+void swc_window_set_tearing_policy(struct swc_window *window, uint32_t policy);
+
 /**
  * Begin an interactive move of the specified window.
  */
@@ -325,9 +353,34 @@ struct swc_manager {
 	void (*deactivate)(void);
 };
 
+/**
+ * Sets how many milliseconds before the next vertical blank of a screen its
+ * repaint starts. Larger margins leave more time for composition, smaller
+ * ones let client commits made later in the frame be displayed sooner.
+ *
+ * The default is 7 milliseconds.
+ */
+void swc_set_repaint_margin(uint32_t margin);
+
+/**
+ * Sets how many milliseconds before the repaint of a screen the clients on it
+ * are sent frame callbacks. Clients that render within this budget have their
+ * content displayed at the next vertical blank, rather than a frame later
+ * than the one their callback followed.
+ *
+ * The default is 0, which sends frame callbacks as soon as the previous frame
+ * is displayed, giving clients most of a refresh cycle to render.
+ */
+void swc_set_frame_budget(uint32_t budget);
+
 /**
  * Initializes the compositor using the specified display, event_loop, and
  * manager.
+ *
+ * If the SWC_BACKEND environment variable is set to "headless", screens are
+ * rendered into memory instead of DRM outputs, and swc-launch is not needed.
+ * Their modes are taken from SWC_HEADLESS_SCREENS, a comma-separated list of
+ * WIDTHxHEIGHT@REFRESH (for example "1920x1080@60,1280x720@30").
  */
 bool swc_initialize(struct wl_display *display, struct wl_event_loop *event_loop, const struct swc_manager *manager);
 
@@ -0,0 +1,124 @@
+/* swc: libswc/tearing_control.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tearing_control.h"
+#include "surface.h"
+#include "util.h"
+
+#include <wayland-server.h>
+#include "tearing-control-v1-server-protocol.h"
+
+struct tearing_control {
+	struct wl_resource *resource;
+	struct surface *surface;
+	struct wl_listener surface_destroy_listener;
+};
+
+static void
+set_presentation_hint(struct wl_client *client, struct wl_resource *resource, uint32_t hint)
+{
+	struct tearing_control *control = wl_resource_get_user_data(resource);
+
+	if (control->surface)
+		control->surface->pending.state.tearing = hint == WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC;
+}
+
+static const struct wp_tearing_control_v1_interface tearing_control_impl = {
+	.set_presentation_hint = set_presentation_hint,
+	.destroy = destroy_resource,
+};
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct tearing_control *control = wl_container_of(listener, control, surface_destroy_listener);
+
+	wl_list_remove(&control->surface_destroy_listener.link);
+	control->surface = NULL;
+}
+
+static void
+tearing_control_destroy(struct wl_resource *resource)
+{
+	struct tearing_control *control = wl_resource_get_user_data(resource);
+
+	/* The hint reverts to vsync with the surface's next commit. */
+	if (control->surface) {
+		control->surface->pending.state.tearing = false;
+		wl_list_remove(&control->surface_destroy_listener.link);
+	}
+	free(control);
+}
+
+static void
+get_tearing_control(struct wl_client *client, struct wl_resource *resource, uint32_t id, struct wl_resource *surface_resource)
+{
+	struct tearing_control *control;
+
+	if (wl_resource_get_destroy_listener(surface_resource, &handle_surface_destroy)) {
+		wl_resource_post_error(resource, WP_TEARING_CONTROL_MANAGER_V1_ERROR_TEARING_CONTROL_EXISTS,
+		                       "surface already has a tearing control object");
+		return;
+	}
+
+	control = malloc(sizeof(*control));
+	if (!control)
+		goto error0;
+	control->resource = wl_resource_create(client, &wp_tearing_control_v1_interface, wl_resource_get_version(resource), id);
+	if (!control->resource)
+		goto error1;
+	control->surface = wl_resource_get_user_data(surface_resource);
+	control->surface_destroy_listener.notify = &handle_surface_destroy;
+	wl_resource_add_destroy_listener(surface_resource, &control->surface_destroy_listener);
+	wl_resource_set_implementation(control->resource, &tearing_control_impl, control, &tearing_control_destroy);
+	return;
+
+error1:
+	free(control);
+error0:
+	wl_resource_post_no_memory(resource);
+}
+
+static const struct wp_tearing_control_manager_v1_interface tearing_control_manager_impl = {
+	.destroy = destroy_resource,
+	.get_tearing_control = get_tearing_control,
+};
+
+static void
+bind_tearing_control_manager(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+	struct wl_resource *resource;
+
+	resource = wl_resource_create(client, &wp_tearing_control_manager_v1_interface, version, id);
+	if (!resource) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &tearing_control_manager_impl, NULL, NULL);
+}
+
+struct wl_global *
+tearing_control_manager_create(struct wl_display *display)
+{
+	return wl_global_create(display, &wp_tearing_control_manager_v1_interface, 1, NULL, &bind_tearing_control_manager);
+}
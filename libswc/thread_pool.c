@@ -0,0 +1,162 @@
+/* swc: libswc/thread_pool.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "thread_pool.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct thread_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t work, done;
+
+	thread_pool_task task;
+	void *data;
+	/* The next index to be handed out, the number of indices, and the number
+	 * of calls yet to complete. */
+	unsigned next, count, pending;
+	bool quit;
+
+	unsigned num_threads;
+	pthread_t threads[];
+};
+
+/* Must be called with the mutex held. */
+static void
+run_tasks(struct thread_pool *pool)
+{
+	unsigned index;
+
+	while (pool->next < pool->count) {
+		index = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+		pool->task(pool->data, index);
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+	}
+}
+
+static void *
+worker(void *data)
+{
+	struct thread_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (!pool->quit && pool->next >= pool->count)
+			pthread_cond_wait(&pool->work, &pool->mutex);
+		if (pool->quit)
+			break;
+		run_tasks(pool);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+struct thread_pool *
+thread_pool_create(unsigned num_threads)
+{
+	struct thread_pool *pool;
+	sigset_t mask, old_mask;
+
+	if (!(pool = malloc(sizeof(*pool) + num_threads * sizeof(pool->threads[0]))))
+		goto error0;
+
+	pool->next = 0;
+	pool->count = 0;
+	pool->pending = 0;
+	pool->quit = false;
+	pool->num_threads = 0;
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		goto error1;
+	if (pthread_cond_init(&pool->work, NULL) != 0)
+		goto error2;
+	if (pthread_cond_init(&pool->done, NULL) != 0)
+		goto error3;
+
+	/* Signals are handled by the main loop, which may only block them after
+	 * the threads are created, so the threads inherit a full mask. */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+	for (; pool->num_threads < num_threads; ++pool->num_threads) {
+		if (pthread_create(&pool->threads[pool->num_threads], NULL, &worker, pool) != 0) {
+			WARNING("Could only create %u of %u threads\n", pool->num_threads, num_threads);
+			break;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+	return pool;
+
+error3:
+	pthread_cond_destroy(&pool->work);
+error2:
+	pthread_mutex_destroy(&pool->mutex);
+error1:
+	free(pool);
+error0:
+	return NULL;
+}
+
+void
+thread_pool_destroy(struct thread_pool *pool)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->num_threads; ++i)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+}
+
+void
+thread_pool_run(struct thread_pool *pool, thread_pool_task task, void *data, unsigned count)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->data = data;
+	pool->next = 0;
+	pool->count = count;
+	pool->pending = count;
+	pthread_cond_broadcast(&pool->work);
+
+	/* Work alongside the pool rather than sit idle. */
+	run_tasks(pool);
+	while (pool->pending > 0)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,40 @@
+/* swc: libswc/thread_pool.h
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SWC_THREAD_POOL_H
+#define SWC_THREAD_POOL_H
+
+struct thread_pool;
+
+typedef void (*thread_pool_task)(void *data, unsigned index);
+
+struct thread_pool *thread_pool_create(unsigned num_threads);
+void thread_pool_destroy(struct thread_pool *pool);
+
+/**
+ * Calls task for each index from 0 to count - 1, spread over the pool's
+ * threads and the calling thread, and returns once all calls have completed.
+ */
+void thread_pool_run(struct thread_pool *pool, thread_pool_task task, void *data, unsigned count);
+
+#endif
@@ -30,7 +30,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include <pixman.h>
 #include <wayland-util.h>
 
@@ -69,13 +69,17 @@ struct wl_client;
 void remove_resource(struct wl_resource *resource);
 void destroy_resource(struct wl_client *client, struct wl_resource *resource);
 
+/**
+ * Returns the current time in milliseconds, on the same clock as input event
+ * and page flip timestamps.
+ */
 static inline uint32_t
 get_time(void)
 {
-	struct timeval timeval;
+	struct timespec ts;
 
-	gettimeofday(&timeval, NULL);
-	return timeval.tv_sec * 1000 + timeval.tv_usec / 1000;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
 extern pixman_box32_t infinite_extents;
@@ -156,8 +156,16 @@ view_update_screens(struct view *view)
 }
 
 void
-view_frame(struct view *view, uint32_t time)
+view_frame(struct view *view, const struct frame_info *info)
 {
 	struct view_handler *handler;
-	HANDLE(view, handler, frame, time);
+	HANDLE(view, handler, frame, info);
+}
+
+uint32_t
+frame_info_msec(const struct frame_info *info)
+{
+	if (!info)
+		return get_time();
+	return info->time.tv_sec * 1000 + info->time.tv_nsec / 1000000;
 }
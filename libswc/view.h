@@ -26,6 +26,7 @@
 
 #include "swc.h"
 
+#include <time.h>
 #include <wayland-util.h>
 
 /**
@@ -50,6 +51,23 @@ struct view {
 	struct wld_buffer *buffer;
 };
 
+/**
+ * Describes when and how a frame was displayed.
+ */
+struct frame_info {
+	/* The time the frame started scanning out, on the clock of the DRM
+	 * device's timestamps. */
+	struct timespec time;
+	/* The duration of a refresh cycle in nanoseconds, or 0 if unknown. */
+	uint32_t refresh;
+	/* The vertical blank counter of the screen. */
+	uint64_t sequence;
+	/* A mask of wp_presentation_feedback kind flags. */
+	uint32_t flags;
+	/* The screen the frame was displayed on, or NULL if unknown. */
+	struct screen *screen;
+};
+
 struct view_handler {
 	const struct view_handler_impl *impl;
 	struct wl_list link;
@@ -68,7 +86,7 @@ struct view_impl {
 
 struct view_handler_impl {
 	/* Called when the view has displayed the next frame. */
-	void (*frame)(struct view_handler *handler, uint32_t time);
+	void (*frame)(struct view_handler *handler, const struct frame_info *info);
 	/* Called when a new buffer is attached to the view. */
 	void (*attach)(struct view_handler *handler);
 	/* Called after the view's position changes. */
@@ -124,9 +142,15 @@ void view_update_screens(struct view *view);
  * Send a new frame event through the view's event signal.
  *
  * This should be called by the view itself when the next frame is visible to
- * the user. If time information is not available, get_time() can be passed
- * instead.
+ * the user. If timing information is not available, info can be NULL, in
+ * which case the current time is used.
+ */
+void view_frame(struct view *view, const struct frame_info *info);
+
+/**
+ * Returns the time the frame was displayed in milliseconds, or the current
+ * time if info is NULL.
  */
-void view_frame(struct view *view, uint32_t time);
+uint32_t frame_info_msec(const struct frame_info *info);
 
 #endif
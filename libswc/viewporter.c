@@ -0,0 +1,169 @@
+/* swc: libswc/viewporter.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "viewporter.h"
+#include "surface.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <wayland-server.h>
+#include "viewporter-server-protocol.h"
+
+struct viewport {
+	struct wl_resource *resource;
+	struct surface *surface;
+	struct wl_listener surface_destroy_listener;
+};
+
+static void
+set_source(struct wl_client *client, struct wl_resource *resource, wl_fixed_t x, wl_fixed_t y, wl_fixed_t width, wl_fixed_t height)
+{
+	struct viewport *viewport = wl_resource_get_user_data(resource);
+	struct surface *surface = viewport->surface;
+	const wl_fixed_t unset = wl_fixed_from_int(-1);
+
+	if (!surface) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE, "surface was destroyed");
+		return;
+	}
+	if (!(x == unset && y == unset && width == unset && height == unset) && (x < 0 || y < 0 || width <= 0 || height <= 0)) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE, "invalid source rectangle");
+		return;
+	}
+
+	surface->pending.commit |= SURFACE_COMMIT_VIEWPORT;
+	surface->pending.state.viewport.src_x = x;
+	surface->pending.state.viewport.src_y = y;
+	surface->pending.state.viewport.src_width = width;
+	surface->pending.state.viewport.src_height = height;
+}
+
+static void
+set_destination(struct wl_client *client, struct wl_resource *resource, int32_t width, int32_t height)
+{
+	struct viewport *viewport = wl_resource_get_user_data(resource);
+	struct surface *surface = viewport->surface;
+
+	if (!surface) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE, "surface was destroyed");
+		return;
+	}
+	if (!(width == -1 && height == -1) && (width <= 0 || height <= 0)) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE, "invalid destination size");
+		return;
+	}
+
+	surface->pending.commit |= SURFACE_COMMIT_VIEWPORT;
+	surface->pending.state.viewport.width = width;
+	surface->pending.state.viewport.height = height;
+}
+
+static const struct wp_viewport_interface viewport_impl = {
+	.destroy = destroy_resource,
+	.set_source = set_source,
+	.set_destination = set_destination,
+};
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct viewport *viewport = wl_container_of(listener, viewport, surface_destroy_listener);
+
+	wl_list_remove(&viewport->surface_destroy_listener.link);
+	viewport->surface = NULL;
+}
+
+static void
+viewport_destroy(struct wl_resource *resource)
+{
+	struct viewport *viewport = wl_resource_get_user_data(resource);
+	struct surface *surface = viewport->surface;
+
+	/* The buffer is shown as is again from the surface's next commit. */
+	if (surface) {
+		surface->pending.commit |= SURFACE_COMMIT_VIEWPORT;
+		surface->pending.state.viewport.src_x = wl_fixed_from_int(-1);
+		surface->pending.state.viewport.src_y = wl_fixed_from_int(-1);
+		surface->pending.state.viewport.src_width = wl_fixed_from_int(-1);
+		surface->pending.state.viewport.src_height = wl_fixed_from_int(-1);
+		surface->pending.state.viewport.width = -1;
+		surface->pending.state.viewport.height = -1;
+		surface->viewport = NULL;
+		wl_list_remove(&viewport->surface_destroy_listener.link);
+	}
+	free(viewport);
+}
+
+static void
+get_viewport(struct wl_client *client, struct wl_resource *resource, uint32_t id, struct wl_resource *surface_resource)
+{
+	struct surface *surface = wl_resource_get_user_data(surface_resource);
+	struct viewport *viewport;
+
+	if (surface->viewport) {
+		wl_resource_post_error(resource, WP_VIEWPORTER_ERROR_VIEWPORT_EXISTS, "surface already has a viewport");
+		return;
+	}
+
+	viewport = malloc(sizeof(*viewport));
+	if (!viewport)
+		goto error0;
+	viewport->resource = wl_resource_create(client, &wp_viewport_interface, wl_resource_get_version(resource), id);
+	if (!viewport->resource)
+		goto error1;
+	viewport->surface = surface;
+	viewport->surface_destroy_listener.notify = &handle_surface_destroy;
+	wl_resource_add_destroy_listener(surface_resource, &viewport->surface_destroy_listener);
+	wl_resource_set_implementation(viewport->resource, &viewport_impl, viewport, &viewport_destroy);
+	surface->viewport = viewport->resource;
+	return;
+
+error1:
+	free(viewport);
+error0:
+	wl_resource_post_no_memory(resource);
+}
+
+static const struct wp_viewporter_interface viewporter_impl = {
+	.destroy = destroy_resource,
+	.get_viewport = get_viewport,
+};
+
+static void
+bind_viewporter(struct wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+	struct wl_resource *resource;
+
+	resource = wl_resource_create(client, &wp_viewporter_interface, version, id);
+	if (!resource) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &viewporter_impl, NULL, NULL);
+}
+
+struct wl_global *
+viewporter_create(struct wl_display *display)
+{
+	return wl_global_create(display, &wp_viewporter_interface, 1, NULL, &bind_viewporter);
+}
@@ -26,11 +26,28 @@
 #include "internal.h"
 #include "shm.h"
 #include "util.h"
+#include <stdlib.h>
 #include <wayland-server.h>
 
 #include <wld/pixman.h>
 #include <wld/wld.h>
 
+enum {
+	WLD_USER_OBJECT_WAYLAND_BUFFER = WLD_USER_ID + 6
+};
+
+/* The state of a client buffer's wl_buffer, which may outlive it. */
+struct wayland_buffer {
+	struct wld_exporter exporter;
+	struct wld_destructor destructor;
+	struct wl_resource *resource;
+
+	/* The number of locks held on the buffer while it may be scanned out,
+	 * and whether its release was deferred until they are dropped. */
+	unsigned locks;
+	bool release_pending;
+};
+
 static const struct wl_buffer_interface buffer_impl = {
 	.destroy = destroy_resource,
 };
@@ -44,20 +61,116 @@ wayland_buffer_get(struct wl_resource *resource)
 	return NULL;
 }
 
+static struct wayland_buffer *
+get_state(struct wld_buffer *buffer)
+{
+	union wld_object object;
+
+	return buffer && wld_export(buffer, WLD_USER_OBJECT_WAYLAND_BUFFER, &object) ? object.ptr : NULL;
+}
+
+static bool
+state_export(struct wld_exporter *exporter, struct wld_buffer *buffer, uint32_t type, union wld_object *object)
+{
+	struct wayland_buffer *state = wl_container_of(exporter, state, exporter);
+
+	switch (type) {
+	case WLD_USER_OBJECT_WAYLAND_BUFFER:
+		object->ptr = state;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void
+state_destroy(struct wld_destructor *destructor)
+{
+	struct wayland_buffer *state = wl_container_of(destructor, state, destructor);
+
+	free(state);
+}
+
 static void
 destroy_buffer(struct wl_resource *resource)
 {
 	struct wld_buffer *buffer = wl_resource_get_user_data(resource);
+	struct wayland_buffer *state = get_state(buffer);
+
+	if (state)
+		state->resource = NULL;
 	wld_buffer_unreference(buffer);
 }
 
 struct wl_resource *
 wayland_buffer_create_resource(struct wl_client *client, uint32_t version, uint32_t id, struct wld_buffer *buffer)
 {
+	struct wayland_buffer *state = NULL;
 	struct wl_resource *resource;
 
+	/* Buffers that failed to import have no state. Otherwise, the state is
+	 * freed along with the buffer if the resource can't be created. */
+	if (buffer) {
+		if (!(state = malloc(sizeof(*state))))
+			return NULL;
+		state->resource = NULL;
+		state->locks = 0;
+		state->release_pending = false;
+		state->exporter.export = &state_export;
+		wld_buffer_add_exporter(buffer, &state->exporter);
+		state->destructor.destroy = &state_destroy;
+		wld_buffer_add_destructor(buffer, &state->destructor);
+	}
+
 	resource = wl_resource_create(client, &wl_buffer_interface, version, id);
 	if (resource)
 		wl_resource_set_implementation(resource, &buffer_impl, buffer, &destroy_buffer);
+	if (state)
+		state->resource = resource;
 	return resource;
 }
+
+void
+wayland_buffer_release(struct wl_resource *resource)
+{
+	struct wayland_buffer *state = get_state(wayland_buffer_get(resource));
+
+	if (state && state->locks > 0)
+		state->release_pending = true;
+	else
+		wl_buffer_send_release(resource);
+}
+
+void
+wayland_buffer_cancel_release(struct wl_resource *resource)
+{
+	struct wayland_buffer *state = get_state(wayland_buffer_get(resource));
+
+	if (state)
+		state->release_pending = false;
+}
+
+void
+wayland_buffer_lock(struct wld_buffer *buffer)
+{
+	struct wayland_buffer *state = get_state(buffer);
+
+	wld_buffer_reference(buffer);
+	if (state)
+		++state->locks;
+}
+
+void
+wayland_buffer_unlock(struct wld_buffer *buffer)
+{
+	struct wayland_buffer *state = get_state(buffer);
+
+	if (state && --state->locks == 0 && state->release_pending) {
+		state->release_pending = false;
+		if (state->resource)
+			wl_buffer_send_release(state->resource);
+	}
+	wld_buffer_unreference(buffer);
+}
@@ -28,8 +28,27 @@
 
 struct wl_client;
 struct wl_resource;
+struct wld_buffer;
 
 struct wld_buffer *wayland_buffer_get(struct wl_resource *resource);
 struct wl_resource *wayland_buffer_create_resource(struct wl_client *client, uint32_t version, uint32_t id, struct wld_buffer *buffer);
 
+/**
+ * Releases the buffer to its client, or if it is locked, once the last lock
+ * is dropped.
+ */
+void wayland_buffer_release(struct wl_resource *resource);
+
+/**
+ * Cancels a deferred release of a buffer that its client attached again.
+ */
+void wayland_buffer_cancel_release(struct wl_resource *resource);
+
+/**
+ * References the buffer and holds back its release while it may still be
+ * scanned out. Buffers that are not client buffers are only referenced.
+ */
+void wayland_buffer_lock(struct wld_buffer *buffer);
+void wayland_buffer_unlock(struct wld_buffer *buffer);
+
 #endif
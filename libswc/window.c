@@ -257,6 +257,15 @@ swc_window_set_border(struct swc_window *window, uint32_t border_color, uint32_t
 	compositor_view_set_border_width(view, border_width);
 }
 
+EXPORT void
+swc_window_set_tearing_policy(struct swc_window *base, uint32_t policy)
+{
+	struct window *window = INTERNAL(base);
+
+	window->tearing_policy = policy;
+	view_update(&window->view->base);
+}
+
 EXPORT void
 swc_window_begin_move(struct swc_window *window)
 {
@@ -377,6 +386,7 @@ window_initialize(struct window *window, const struct window_impl *impl, struct
 	window->view->window = window;
 	window->managed = false;
 	window->mode = WINDOW_MODE_STACKED;
+	window->tearing_policy = SWC_TEARING_CLIENT;
 	window->move.pending = false;
 	window->move.interaction.active = false;
 	window->move.interaction.handler = (struct pointer_handler){
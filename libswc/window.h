@@ -52,6 +52,7 @@ struct window {
 	struct view_handler view_handler;
 	bool managed;
 	unsigned mode;
+	uint32_t tearing_policy;
 
 	struct {
 		struct window_pointer_interaction interaction;
@@ -0,0 +1,183 @@
+/* swc: libswc/yuv.c
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "yuv.h"
+#include "util.h"
+
+#include <string.h>
+#include <drm_fourcc.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Pixels converted at a time, whose samples are first gathered into 8-bit
+ * rows if they are not stored as such. */
+#define CHUNK_SIZE 64
+
+uint32_t
+yuv_num_planes(uint32_t format)
+{
+	switch (format) {
+	case DRM_FORMAT_NV12:
+	case DRM_FORMAT_P010:
+		return 2;
+	case DRM_FORMAT_YUV420:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+void
+yuv_plane_size(uint32_t format, uint32_t plane, uint32_t width, uint32_t height, uint32_t *row_size, uint32_t *rows)
+{
+	uint32_t sample_size = format == DRM_FORMAT_P010 ? 2 : 1;
+
+	if (plane == 0) {
+		*row_size = width * sample_size;
+		*rows = height;
+	} else {
+		/* NV12 and P010 interleave the two chroma samples. */
+		*row_size = (width + 1) / 2 * sample_size * (format == DRM_FORMAT_YUV420 ? 1 : 2);
+		*rows = (height + 1) / 2;
+	}
+}
+
+static inline uint8_t
+clamp(int32_t value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+/* The coefficients are scaled by 64. Sums that don't fit in 16 bits saturate,
+ * which the SIMD code relies on, are clamped either way. */
+static inline uint32_t
+convert_pixel(int32_t y, int32_t u, int32_t v)
+{
+	y = (y - 16) * 75 + 32;
+	u -= 128;
+	v -= 128;
+
+	return 0xff000000 | clamp((y + 102 * v) >> 6) << 16 | clamp((y - 25 * u - 52 * v) >> 6) << 8 | clamp((y + 129 * u) >> 6);
+}
+
+/**
+ * Converts a row of pixels starting at an even column, with one chroma sample
+ * for each pair of them.
+ */
+static void
+convert_row(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, uint32_t width)
+{
+	uint32_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128(), alpha = _mm_set1_epi8(-1);
+	const __m128i y_offset = _mm_set1_epi16(16), uv_offset = _mm_set1_epi16(128), round = _mm_set1_epi16(32);
+	const __m128i y_coeff = _mm_set1_epi16(75), rv_coeff = _mm_set1_epi16(102), gu_coeff = _mm_set1_epi16(25),
+	              gv_coeff = _mm_set1_epi16(52), bu_coeff = _mm_set1_epi16(129);
+	__m128i ys, us, vs, r, g, b, bg, ra;
+	int32_t samples;
+
+	for (; i + 8 <= width; i += 8) {
+		ys = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + i)), zero);
+		memcpy(&samples, u + i / 2, sizeof(samples));
+		us = _mm_cvtsi32_si128(samples);
+		memcpy(&samples, v + i / 2, sizeof(samples));
+		vs = _mm_cvtsi32_si128(samples);
+
+		/* Each chroma sample covers two pixels. */
+		us = _mm_unpacklo_epi8(_mm_unpacklo_epi8(us, us), zero);
+		vs = _mm_unpacklo_epi8(_mm_unpacklo_epi8(vs, vs), zero);
+
+		ys = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(ys, y_offset), y_coeff), round);
+		us = _mm_sub_epi16(us, uv_offset);
+		vs = _mm_sub_epi16(vs, uv_offset);
+
+		r = _mm_srai_epi16(_mm_adds_epi16(ys, _mm_mullo_epi16(vs, rv_coeff)), 6);
+		g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(ys, _mm_mullo_epi16(us, gu_coeff)), _mm_mullo_epi16(vs, gv_coeff)), 6);
+		b = _mm_srai_epi16(_mm_adds_epi16(ys, _mm_mullo_epi16(us, bu_coeff)), 6);
+		r = _mm_packus_epi16(r, r);
+		g = _mm_packus_epi16(g, g);
+		b = _mm_packus_epi16(b, b);
+
+		/* XRGB8888 is stored as B, G, R, X. */
+		bg = _mm_unpacklo_epi8(b, g);
+		ra = _mm_unpacklo_epi8(r, alpha);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(bg, ra));
+	}
+#endif
+
+	for (; i < width; ++i)
+		dst[i] = convert_pixel(y[i], u[i / 2], v[i / 2]);
+}
+
+void
+yuv_convert(uint32_t format, const uint8_t *const planes[], const uint32_t strides[],
+            uint32_t *dst, uint32_t dst_stride, const pixman_box32_t *box)
+{
+	uint8_t y_row[CHUNK_SIZE], u_row[CHUNK_SIZE / 2], v_row[CHUNK_SIZE / 2];
+	const uint8_t *y, *u, *v, *src;
+	int32_t row, x, width, i;
+
+	for (row = box->y1; row < box->y2; ++row) {
+		for (x = box->x1; x < box->x2; x += width) {
+			width = MIN(box->x2 - x, CHUNK_SIZE);
+			switch (format) {
+			case DRM_FORMAT_NV12:
+				y = planes[0] + row * strides[0] + x;
+				src = planes[1] + row / 2 * strides[1] + x;
+				for (i = 0; i < (width + 1) / 2; ++i) {
+					u_row[i] = src[i * 2];
+					v_row[i] = src[i * 2 + 1];
+				}
+				u = u_row;
+				v = v_row;
+				break;
+			case DRM_FORMAT_P010:
+				/* The samples are little-endian with 10 significant
+				 * high bits, of which the high byte is kept. */
+				src = planes[0] + row * strides[0] + x * 2;
+				for (i = 0; i < width; ++i)
+					y_row[i] = src[i * 2 + 1];
+				src = planes[1] + row / 2 * strides[1] + x * 2;
+				for (i = 0; i < (width + 1) / 2; ++i) {
+					u_row[i] = src[i * 4 + 1];
+					v_row[i] = src[i * 4 + 3];
+				}
+				y = y_row;
+				u = u_row;
+				v = v_row;
+				break;
+			case DRM_FORMAT_YUV420:
+				y = planes[0] + row * strides[0] + x;
+				u = planes[1] + row / 2 * strides[1] + x / 2;
+				v = planes[2] + row / 2 * strides[2] + x / 2;
+				break;
+			default:
+				return;
+			}
+			convert_row(y, u, v, (uint32_t *)((uint8_t *)dst + row * dst_stride) + x, width);
+		}
+	}
+}
@@ -0,0 +1,50 @@
+/* swc: libswc/yuv.h
+ *
+ * Copyright (c) 2026 agx
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SWC_YUV_H
+#define SWC_YUV_H
+
+#include <stdint.h>
+#include <pixman.h>
+
+/**
+ * Returns the number of planes of a YUV format that can be converted, or 0 if
+ * the format is not one of them.
+ */
+uint32_t yuv_num_planes(uint32_t format);
+
+/**
+ * Gets the number of bytes in a row of a plane of a YUV image, and the number
+ * of rows of that plane.
+ */
+void yuv_plane_size(uint32_t format, uint32_t plane, uint32_t width, uint32_t height, uint32_t *row_size, uint32_t *rows);
+
+/**
+ * Converts a part of a 4:2:0 YUV image in limited range BT.601 to XRGB8888.
+ *
+ * The box must lie within the image and start at an even column.
+ */
+void yuv_convert(uint32_t format, const uint8_t *const planes[], const uint32_t strides[],
+                 uint32_t *dst, uint32_t dst_stride, const pixman_box32_t *box);
+
+#endif
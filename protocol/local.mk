@@ -7,7 +7,11 @@ PROTOCOL_EXTENSIONS =           \
     $(dir)/server-decoration.xml\
     $(dir)/swc.xml              \
     $(dir)/wayland-drm.xml      \
+    $(wayland_protocols)/stable/presentation-time/presentation-time.xml \
+    $(wayland_protocols)/stable/viewporter/viewporter.xml \
     $(wayland_protocols)/stable/xdg-shell/xdg-shell.xml \
+    $(wayland_protocols)/staging/single-pixel-buffer/single-pixel-buffer-v1.xml \
+    $(wayland_protocols)/staging/tearing-control/tearing-control-v1.xml \
     $(wayland_protocols)/unstable/linux-dmabuf/linux-dmabuf-unstable-v1.xml \
     $(wayland_protocols)/unstable/xdg-decoration/xdg-decoration-unstable-v1.xml
 
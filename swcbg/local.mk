@@ -8,10 +8,10 @@ $(dir)_TARGETS := $(dir)/swcbg
 
 $(dir): $(dir)/swcbg
 
-$(dir)/swcbg: $(dir)/main.o protocol/swc-protocol.o
+$(dir)/swcbg: $(dir)/main.o protocol/single-pixel-buffer-v1-protocol.o protocol/swc-protocol.o
 	$(link) $($(dir)_PACKAGE_LIBS) -lpng
 
-$(dir)/main.o: protocol/swc-client-protocol.h
+$(dir)/main.o: protocol/single-pixel-buffer-v1-client-protocol.h protocol/swc-client-protocol.h
 
 CLEAN_FILES += $(dir)/main.o
 
@@ -21,6 +21,7 @@
  * SOFTWARE.
  */
 
+#include "protocol/single-pixel-buffer-v1-client-protocol.h"
 #include "protocol/swc-client-protocol.h"
 #include <getopt.h>
 #include <png.h>
@@ -48,6 +49,7 @@ struct swcbg {
 	struct wl_registry *registry;
 	struct wl_compositor *compositor;
 	struct swc_background_manager *background_manager;
+	struct wp_single_pixel_buffer_manager_v1 *single_pixel_buffer_manager;
 	struct wl_list screens;
 	uint32_t color;
 	char *image_path;
@@ -177,6 +179,9 @@ registry_handle_global(void *data, struct wl_registry *registry,
 	else if (strcmp(interface, swc_background_manager_interface.name) == 0)
 		swcbg->background_manager =
 		    wl_registry_bind(registry, id, &swc_background_manager_interface, 1);
+	else if (strcmp(interface, wp_single_pixel_buffer_manager_v1_interface.name) == 0)
+		swcbg->single_pixel_buffer_manager =
+		    wl_registry_bind(registry, id, &wp_single_pixel_buffer_manager_v1_interface, 1);
 	else if (strcmp(interface, swc_screen_interface.name) == 0) {
 		struct screen *screen = malloc(sizeof(*screen));
 		screen->id = id;
@@ -253,6 +258,19 @@ main(int argc, char *argv[])
 		screen->background = swc_background_manager_get_background(
 		    swcbg.background_manager, screen->surface, screen->swc);
 
+		/* A solid color needs no more than a single pixel, which the
+		 * compositor stretches over the screen. */
+		if (!swcbg.img_buffer && swcbg.single_pixel_buffer_manager) {
+			struct wl_buffer *buffer = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(
+			    swcbg.single_pixel_buffer_manager,
+			    (swcbg.color >> 16 & 0xff) * 0x01010101, (swcbg.color >> 8 & 0xff) * 0x01010101,
+			    (swcbg.color & 0xff) * 0x01010101, 0xffffffff);
+			wl_surface_attach(screen->surface, buffer, 0, 0);
+			wl_surface_damage(screen->surface, 0, 0, 1, 1);
+			wl_surface_commit(screen->surface);
+			continue;
+		}
+
 		screen->wld_surface = wld_wayland_create_surface(swcbg.ctx, screen->width, screen->height, WLD_FORMAT_XRGB8888, 0, screen->surface);
 		if (!screen->wld_surface) {
 			fprintf(stderr, "could not create wld surface for screen %u\n", screen->id);